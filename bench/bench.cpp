@@ -0,0 +1,583 @@
+/*************************************************************************************************/
+/**
+	bench.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+/*************************************************************************************************/
+/**
+	Benchmark suite for BeebAsm.
+
+	Generates a set of synthetic stress sources, assembles each one several times with the given
+	beebasm executable, and writes the timings, throughput and peak memory use to a results file,
+	one benchmark per line, in JSON.  If a baseline results file is given, the timings are compared
+	against it.
+
+	Usage: bench [-n runs] [-s scale] [-w workdir] [-o results] [-b baseline] <beebasm>
+
+	This needs POSIX process calls, so it builds on Linux and macOS but not Windows.
+*/
+/*************************************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+using namespace std;
+
+
+// Each generator writes one source file, and returns the number of bytes it assembles
+
+typedef long ( *GENERATOR )( ostream& source, int scale );
+
+
+struct Benchmark
+{
+	const char*		m_pName;
+	GENERATOR		m_pGenerate;
+};
+
+
+struct Result
+{
+	string			m_name;
+	long			m_lines;
+	long			m_bytes;
+	double			m_medianSeconds;
+	double			m_minSeconds;
+	long			m_peakRssKb;
+};
+
+
+
+/*************************************************************************************************/
+/**
+	GenerateFlat()
+
+	A million lines of straight-line code, assembled in blocks with CLEAR in between so that it
+	fits in memory
+*/
+/*************************************************************************************************/
+static long GenerateFlat( ostream& source, int scale )
+{
+	static const char* const instructions[] =
+	{
+		"LDA #&12", "STA &70", "LDX &1234,Y", "INY", "JSR &FFEE", "ADC (&70),Y", "ROL A", "CMP &2000,X"
+	};
+	static const int sizes[] = { 2, 2, 3, 1, 3, 2, 1, 3 };
+
+	const int numLines = 1000000 * scale;
+	const int blockSize = 16000;
+	long bytes = 0;
+
+	source << "ORG &1000" << endl;
+
+	for ( int i = 0; i < numLines; i++ )
+	{
+		if ( i > 0 && i % blockSize == 0 )
+		{
+			source << "CLEAR &1000, &F000" << endl << "ORG &1000" << endl;
+		}
+
+		source << "    " << instructions[ i % 8 ] << endl;
+		bytes += sizes[ i % 8 ];
+	}
+
+	source << "SAVE \"flat\", &1000, P%" << endl;
+
+	return bytes;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	GenerateLabels()
+
+	100,000 labels, each referring to another somewhere else in the source
+*/
+/*************************************************************************************************/
+static long GenerateLabels( ostream& source, int scale )
+{
+	const int numLabels = 100000 * scale;
+	const int blockSize = 16000;
+
+	source << "ORG &1000" << endl;
+
+	for ( int i = 0; i < numLabels; i++ )
+	{
+		if ( i > 0 && i % blockSize == 0 )
+		{
+			source << "CLEAR &1000, &F000" << endl << "ORG &1000" << endl;
+		}
+
+		source << ".label_" << i << " LDA label_" << ( i * 7919L ) % numLabels << endl;
+	}
+
+	source << "SAVE \"labels\", &1000, P%" << endl;
+
+	return 3L * numLabels;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	GenerateScopes()
+
+	FOR loops and braces nested five deep, each iteration defining a label in its own scope
+*/
+/*************************************************************************************************/
+static long GenerateScopes( ostream& source, int scale )
+{
+	const int depth = 5;
+	const int width = 9;
+	long iterations = 1;
+
+	for ( int i = 0; i < depth; i++ )
+	{
+		iterations *= width;
+	}
+
+	for ( int pass = 0; pass < scale; pass++ )
+	{
+		if ( pass > 0 )
+		{
+			source << "CLEAR &1000, &FFFF" << endl;
+		}
+
+		source << "ORG &1000" << endl;
+
+		for ( int i = 0; i < depth; i++ )
+		{
+			source << "FOR v" << i << ", 0, " << width - 1 << endl << "{" << endl << ".local" << i << endl;
+		}
+
+		source << "    EQUB ( v0 + v1 + v2 + v3 + v4 ) AND &FF" << endl;
+
+		for ( int i = 0; i < depth; i++ )
+		{
+			source << "}" << endl << "NEXT" << endl;
+		}
+	}
+
+	source << "SAVE \"scopes\", &1000, P%" << endl;
+
+	return iterations * scale;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	GenerateMacros()
+
+	A macro which calls itself 64 deep, called many times
+*/
+/*************************************************************************************************/
+static long GenerateMacros( ostream& source, int scale )
+{
+	const int depth = 64;
+	const int numCalls = 300;
+
+	source << "MACRO recurse n" << endl;
+	source << "    IF n > 0" << endl;
+	source << "        LDA #n" << endl;
+	source << "        recurse n - 1" << endl;
+	source << "    ENDIF" << endl;
+	source << "ENDMACRO" << endl;
+
+	for ( int pass = 0; pass < scale; pass++ )
+	{
+		if ( pass > 0 )
+		{
+			source << "CLEAR &1000, &F000" << endl;
+		}
+
+		source << "ORG &1000" << endl;
+
+		for ( int i = 0; i < numCalls; i++ )
+		{
+			source << "recurse " << depth << endl;
+		}
+	}
+
+	source << "SAVE \"macros\", &1000, P%" << endl;
+
+	return 2L * depth * numCalls * scale;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	GenerateIncBin()
+
+	A 48K binary file, INCBINed many times over
+*/
+/*************************************************************************************************/
+static long GenerateIncBin( ostream& source, int scale )
+{
+	const int fileSize = 0xC000;
+	const int numIncludes = 40 * scale;
+
+	ofstream binFile( "incbin.bin", ios_base::out | ios_base::binary | ios_base::trunc );
+	unsigned long seed = 12345;
+
+	for ( int i = 0; i < fileSize; i++ )
+	{
+		seed = seed * 1103515245 + 12345;
+		binFile.put( static_cast< char >( seed >> 16 ) );
+	}
+
+	for ( int i = 0; i < numIncludes; i++ )
+	{
+		if ( i > 0 )
+		{
+			source << "CLEAR &1000, &E000" << endl;
+		}
+
+		source << "ORG &1000" << endl << "INCBIN \"incbin.bin\"" << endl;
+	}
+
+	source << "SAVE \"incbin\", &1000, P%" << endl;
+
+	return static_cast< long >( fileSize ) * numIncludes;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	GenerateTrig()
+
+	Sine and cosine tables, built with FOR loops
+*/
+/*************************************************************************************************/
+static long GenerateTrig( ostream& source, int scale )
+{
+	const int tablesPerBlock = 100;
+	const int numBlocks = 10 * scale;
+
+	for ( int i = 0; i < numBlocks; i++ )
+	{
+		if ( i > 0 )
+		{
+			source << "CLEAR &1000, &F000" << endl;
+		}
+
+		source << "ORG &1000" << endl;
+		source << "FOR t, 1, " << tablesPerBlock << endl;
+		source << "    FOR i, 0, 255" << endl;
+		source << "        EQUB INT( 127.5 + 127 * SIN( 2 * PI * i / 256 ) )" << endl;
+		source << "        EQUB INT( 127.5 + 127 * COS( 2 * PI * i / 256 ) )" << endl;
+		source << "    NEXT" << endl;
+		source << "NEXT" << endl;
+	}
+
+	source << "SAVE \"trig\", &1000, P%" << endl;
+
+	return 512L * tablesPerBlock * numBlocks;
+}
+
+
+
+static const Benchmark benchmarks[] =
+{
+	{ "flat",		GenerateFlat },
+	{ "labels",		GenerateLabels },
+	{ "scopes",		GenerateScopes },
+	{ "macros",		GenerateMacros },
+	{ "incbin",		GenerateIncBin },
+	{ "trig",		GenerateTrig }
+};
+
+
+
+/*************************************************************************************************/
+/**
+	RunBeebAsm()
+
+	Assembles a source file once, discarding anything printed
+
+	@param		beebasm			Path of the beebasm executable
+	@param		filename		Source file
+	@param		seconds			Returns the wall time taken
+	@param		rssKb			Returns the peak resident set size of the process
+
+	@return		bool			false if beebasm couldn't be run or failed
+*/
+/*************************************************************************************************/
+static bool RunBeebAsm( const string& beebasm, const string& filename, double& seconds, long& rssKb )
+{
+	timeval start;
+	timeval end;
+
+	gettimeofday( &start, NULL );
+
+	pid_t pid = fork();
+
+	if ( pid == 0 )
+	{
+		int nullFd = open( "/dev/null", O_WRONLY );
+		dup2( nullFd, STDOUT_FILENO );
+		dup2( nullFd, STDERR_FILENO );
+		execl( beebasm.c_str(), beebasm.c_str(), "-i", filename.c_str(), static_cast< char* >( NULL ) );
+		_exit( 127 );
+	}
+
+	int status = 0;
+	rusage usage;
+
+	if ( pid < 0 || wait4( pid, &status, 0, &usage ) != pid )
+	{
+		return false;
+	}
+
+	gettimeofday( &end, NULL );
+
+	seconds = ( end.tv_sec - start.tv_sec ) + ( end.tv_usec - start.tv_usec ) / 1000000.0;
+
+#ifdef __APPLE__
+	rssKb = usage.ru_maxrss / 1024;
+#else
+	rssKb = usage.ru_maxrss;
+#endif
+
+	return WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	ReadBaseline()
+
+	Gets a benchmark's median time from a previous results file
+
+	@param		baseline		Contents of the results file
+	@param		name			Benchmark name
+
+	@return		double			Median time in seconds, or 0 if it isn't in the file
+*/
+/*************************************************************************************************/
+static double ReadBaseline( const string& baseline, const string& name )
+{
+	istringstream file( baseline );
+	string line;
+	string key = "\"name\": \"" + name + "\"";
+
+	while ( getline( file, line ) )
+	{
+		size_t pos = line.find( "\"median_seconds\": " );
+
+		if ( line.find( key ) != string::npos && pos != string::npos )
+		{
+			return strtod( line.c_str() + pos + strlen( "\"median_seconds\": " ), NULL );
+		}
+	}
+
+	return 0.0;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	main()
+*/
+/*************************************************************************************************/
+int main( int argc, char* argv[] )
+{
+	int runs = 5;
+	int scale = 1;
+	string workDir = "bench-work";
+	string resultsFile = "results.json";
+	string baselineFile;
+	string beebasm;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc )
+		{
+			runs = max( 1, atoi( argv[ ++i ] ) );
+		}
+		else if ( strcmp( argv[i], "-s" ) == 0 && i + 1 < argc )
+		{
+			scale = max( 1, atoi( argv[ ++i ] ) );
+		}
+		else if ( strcmp( argv[i], "-w" ) == 0 && i + 1 < argc )
+		{
+			workDir = argv[ ++i ];
+		}
+		else if ( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc )
+		{
+			resultsFile = argv[ ++i ];
+		}
+		else if ( strcmp( argv[i], "-b" ) == 0 && i + 1 < argc )
+		{
+			baselineFile = argv[ ++i ];
+		}
+		else if ( argv[i][0] != '-' && beebasm.empty() )
+		{
+			beebasm = argv[i];
+		}
+		else
+		{
+			cerr << "Usage: bench [-n runs] [-s scale] [-w workdir] [-o results] [-b baseline] <beebasm>" << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// The sources are generated and assembled in the work directory, so make the other paths
+	// absolute first
+
+	char* pPath = realpath( beebasm.c_str(), NULL );
+
+	if ( pPath == NULL )
+	{
+		cerr << "Can't find beebasm executable: " << beebasm << endl;
+		return EXIT_FAILURE;
+	}
+
+	beebasm = pPath;
+	free( pPath );
+
+	ifstream baselineStream( baselineFile.c_str() );
+	bool bCompare = !baselineFile.empty() && baselineStream;
+	string baseline;
+
+	if ( bCompare )
+	{
+		ostringstream contents;
+		contents << baselineStream.rdbuf();
+		baseline = contents.str();
+	}
+	else if ( !baselineFile.empty() )
+	{
+		cout << "No baseline in " << baselineFile << endl;
+	}
+
+	mkdir( workDir.c_str(), 0777 );
+
+	ofstream results( resultsFile.c_str() );
+
+	if ( !results || chdir( workDir.c_str() ) != 0 )
+	{
+		cerr << "Can't write results to " << resultsFile << " or use work directory " << workDir << endl;
+		return EXIT_FAILURE;
+	}
+
+	vector< Result > allResults;
+
+	printf( "%-8s %10s %10s %10s %14s %14s %10s", "name", "lines", "bytes", "median(s)", "lines/s", "bytes/s", "rss(KB)" );
+	printf( bCompare ? " %12s %8s\n" : "\n", "baseline(s)", "change" );
+
+	for ( size_t b = 0; b < sizeof benchmarks / sizeof benchmarks[ 0 ]; b++ )
+	{
+		Result result;
+		result.m_name = benchmarks[ b ].m_pName;
+
+		string filename = result.m_name + ".6502";
+		ostringstream source;
+		result.m_bytes = benchmarks[ b ].m_pGenerate( source, scale );
+		string text = source.str();
+		result.m_lines = static_cast< long >( count( text.begin(), text.end(), '\n' ) );
+
+		ofstream sourceFile( filename.c_str() );
+		sourceFile << text;
+		sourceFile.close();
+
+		vector< double > times;
+		result.m_peakRssKb = 0;
+
+		for ( int run = 0; run < runs; run++ )
+		{
+			double seconds;
+			long rssKb;
+
+			if ( !RunBeebAsm( beebasm, filename, seconds, rssKb ) )
+			{
+				cerr << "beebasm failed to assemble " << workDir << "/" << filename << endl;
+				return EXIT_FAILURE;
+			}
+
+			times.push_back( seconds );
+			result.m_peakRssKb = max( result.m_peakRssKb, rssKb );
+		}
+
+		sort( times.begin(), times.end() );
+		result.m_medianSeconds = times[ times.size() / 2 ];
+		result.m_minSeconds = times[ 0 ];
+		allResults.push_back( result );
+
+		printf( "%-8s %10ld %10ld %10.4f %14.0f %14.0f %10ld", result.m_name.c_str(), result.m_lines, result.m_bytes,
+				result.m_medianSeconds, result.m_lines / result.m_medianSeconds, result.m_bytes / result.m_medianSeconds,
+				result.m_peakRssKb );
+
+		if ( bCompare )
+		{
+			double before = ReadBaseline( baseline, result.m_name );
+
+			if ( before > 0.0 )
+			{
+				printf( " %12.4f %+7.1f%%", before, ( result.m_medianSeconds / before - 1.0 ) * 100.0 );
+			}
+		}
+
+		printf( "\n" );
+		fflush( stdout );
+	}
+
+	results << "{" << endl;
+	results << "  \"runs\": " << runs << "," << endl;
+	results << "  \"scale\": " << scale << "," << endl;
+	results << "  \"benchmarks\": [" << endl;
+
+	for ( vector< Result >::const_iterator it = allResults.begin(); it != allResults.end(); ++it )
+	{
+		char line[ 512 ];
+		sprintf( line, "    { \"name\": \"%s\", \"lines\": %ld, \"bytes\": %ld, \"median_seconds\": %.6f, \"min_seconds\": %.6f, "
+					   "\"lines_per_sec\": %.0f, \"bytes_per_sec\": %.0f, \"peak_rss_kb\": %ld }%s",
+				 it->m_name.c_str(), it->m_lines, it->m_bytes, it->m_medianSeconds, it->m_minSeconds,
+				 it->m_lines / it->m_medianSeconds, it->m_bytes / it->m_medianSeconds, it->m_peakRssKb,
+				 ( it + 1 != allResults.end() ) ? "," : "" );
+		results << line << endl;
+	}
+
+	results << "  ]" << endl << "}" << endl;
+
+	return EXIT_SUCCESS;
+}
@@ -24,7 +24,7 @@
 /*************************************************************************************************/
 
 #include "BASIC.h"
-#include <sstream>
+#include "assemblycontext.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -211,15 +211,14 @@ const char *ErrorTable[] =
 	"Malformed BASIC program or not running BASIC",
 	"BASIC program appears to run past the end of RAM"
 };
-std::ostringstream DynamicErrorText;
-std::string DynamicErrorTextString;
+/* the state below is per thread, so that separate threads can import and export at once */
+BEEBASM_THREAD_LOCAL char DynamicErrorText[128];
 
-int ErrorNum;
+BEEBASM_THREAD_LOCAL int ErrorNum;
 
 const char *GetBASICError()
 {
-	DynamicErrorTextString = DynamicErrorText.str();
-	return ErrorNum >= 0 ? ErrorTable[ErrorNum] : DynamicErrorTextString.c_str();
+	return ErrorNum >= 0 ? ErrorTable[ErrorNum] : DynamicErrorText;
 }
 
 int GetBASICErrorNum()
@@ -374,16 +373,16 @@ bool ExportBASIC(const char *Filename, Uint8 *Memory)
 							(v >= '0' && v <= '9')\
 						)
 
-char IncomingBuffer[9];
-Uint8 Token, NextChar;
-unsigned int IncomingPointer;
-FILE *inputfile;
-bool EndOfFile, NumberStart;
-unsigned int NumberValue, NumberLength;
-int CurLine;
+BEEBASM_THREAD_LOCAL char IncomingBuffer[9];
+BEEBASM_THREAD_LOCAL Uint8 Token, NextChar;
+BEEBASM_THREAD_LOCAL unsigned int IncomingPointer;
+BEEBASM_THREAD_LOCAL FILE *inputfile;
+BEEBASM_THREAD_LOCAL bool EndOfFile, NumberStart;
+BEEBASM_THREAD_LOCAL unsigned int NumberValue, NumberLength;
+BEEBASM_THREAD_LOCAL int CurLine;
 
-Uint8 *Memory;
-Uint16 Addr;
+BEEBASM_THREAD_LOCAL Uint8 *Memory;
+BEEBASM_THREAD_LOCAL Uint16 Addr;
 
 inline bool WriteByte(Uint8 value)
 {
@@ -493,7 +492,7 @@ bool CopyStringLiteral()
 	if(IncomingBuffer[0] != '"') // stopped going for some reason other than a close quote
 	{
 		ErrorNum = -1;
-		DynamicErrorText << "Malformed string literal on line " << CurLine;
+		sprintf(DynamicErrorText, "Malformed string literal on line %d", CurLine);
 		return false;
 	}
 
@@ -704,6 +703,7 @@ bool ImportBASIC(const char *Filename, Uint8 *Mem, int* Size)
 	/* store memory target to global var */
 	Memory = Mem;
 	ErrorNum = 0;
+	DynamicErrorText[0] = '\0';
 	Addr = 0;
 
 #if 0
@@ -765,7 +765,7 @@ bool ImportBASIC(const char *Filename, Uint8 *Mem, int* Size)
 				if (NumberValue <= LastLineNumber)
 				{
 					ErrorNum = -1;
-					DynamicErrorText << "Out of sequence line numbers (" << LastLineNumber << " followed by " << NumberValue << ") at line " << CurLine;
+					sprintf(DynamicErrorText, "Out of sequence line numbers (%u followed by %u) at line %d", LastLineNumber, NumberValue, CurLine);
 					break;
 				}
 				LastLineNumber = NumberValue;
@@ -779,7 +779,7 @@ bool ImportBASIC(const char *Filename, Uint8 *Mem, int* Size)
 			if(LastLineNumber >= 32768)
 			{
 				ErrorNum = -1;
-				DynamicErrorText << "Malformed line number at line " << CurLine;
+				sprintf(DynamicErrorText, "Malformed line number at line %d", CurLine);
 				break;
 			}
 			/* inject into memory */
@@ -796,7 +796,7 @@ bool ImportBASIC(const char *Filename, Uint8 *Mem, int* Size)
 		if(Length >= 256)
 		{
 			ErrorNum = -1;
-			DynamicErrorText << "Overly long line at line " << CurLine;
+			sprintf(DynamicErrorText, "Overly long line at line %d", CurLine);
 			break;
 		}
 		Memory[LengthAddr] = static_cast<Uint8>(Length);
@@ -38,12 +38,14 @@ using namespace std;
 /**
 	AsmException_FileAccessError::Print()
 
-	Outputs to stderr an error message relating to an I/O exception
+	Outputs an error message relating to an I/O exception
+
+	@param		stream			Stream to output to, normally cerr
 */
 /*************************************************************************************************/
-void AsmException_FileError::Print() const
+void AsmException_FileError::Print( ostream& stream ) const
 {
-	cerr << "Error: " << m_filename << ": " << Message() << endl;
+	stream << "Error: " << m_filename << ": " << Message() << endl;
 }
 
 
@@ -52,28 +54,30 @@ void AsmException_FileError::Print() const
 /**
 	AsmException_SyntaxError::Print()
 
-	Outputs to stderr an error message regarding a syntax error
+	Outputs an error message regarding a syntax error
+
+	@param		stream			Stream to output to, normally cerr
 */
 /*************************************************************************************************/
-void AsmException_SyntaxError::Print() const
+void AsmException_SyntaxError::Print( ostream& stream ) const
 {
 	assert( !m_filename.empty() );
 	assert( !m_lineNumber.empty() );
 	assert( m_filename.size() == m_lineNumber.size() ) ;
 
-	cerr << ErrorLocation(0);
-	cerr << ": error: ";
-	cerr << Message() << m_extra << endl << endl;
-	cerr << m_line << endl;
-	cerr << string( m_column, ' ' ) << "^" << endl;
+	stream << ErrorLocation(0);
+	stream << ": error: ";
+	stream << Message() << m_extra << endl << endl;
+	stream << m_line << endl;
+	stream << string( m_column, ' ' ) << "^" << endl;
 
 	if ( m_filename.size() > 1 )
 	{
-		cerr << endl;
-		cerr << "Call stack:" << endl;
+		stream << endl;
+		stream << "Call stack:" << endl;
 		for (size_t i = 1; i < m_filename.size(); i++)
 		{
-			cerr << ErrorLocation(i) << endl;
+			stream << ErrorLocation(i) << endl;
 		}
 	}
 }
@@ -24,6 +24,7 @@
 #define ASMEXCEPTION_H_
 
 
+#include <iosfwd>
 #include <string>
 #include <vector>
 
@@ -42,7 +43,26 @@ public:
 	AsmException() {}
 	virtual ~AsmException() {}
 
-	virtual void Print() const = 0;
+	virtual void Print( std::ostream& stream ) const = 0;
+};
+
+
+/*************************************************************************************************/
+/**
+	@class		AsmException_SinglePassFailed
+
+	Thrown when single pass assembly meets something it can't resolve without a second pass; the
+	source is then assembled again in the usual two passes, which report any real error
+*/
+/*************************************************************************************************/
+class AsmException_SinglePassFailed : public AsmException
+{
+public:
+
+	AsmException_SinglePassFailed() {}
+	virtual ~AsmException_SinglePassFailed() {}
+
+	virtual void Print( std::ostream& ) const {}
 };
 
 
@@ -64,13 +84,15 @@ public:
 
 	virtual ~AsmException_FileError() {}
 
-	virtual void Print() const;
+	virtual void Print( std::ostream& stream ) const;
 
 	virtual const char* Message() const
 	{
 		return "Unspecified file error.";
 	}
 
+	const std::string& GetFilename() const			{ return m_filename; }
+
 protected:
 
 	std::string			m_filename;
@@ -138,12 +160,21 @@ public:
 	void SetFilename( const std::string& filename )	{ m_filename.push_back( filename ); }
 	void SetLineNumber( int lineNumber )		{ m_lineNumber.push_back( lineNumber ); }
 
-	virtual void Print() const;
+	virtual void Print( std::ostream& stream ) const;
 	virtual const char* Message() const
 	{
 		return "Unspecified syntax error.";
 	}
 
+	// The location of the error is the first filename and line number; any others are the
+	// locations of the INCLUDEs and macro calls which led to it
+
+	std::string GetMessage() const					{ return Message() + m_extra; }
+	const std::string& GetLine() const				{ return m_line; }
+	int GetColumn() const							{ return m_column; }
+	const std::vector<std::string>& GetFilenames() const	{ return m_filename; }
+	const std::vector<int>& GetLineNumbers() const	{ return m_lineNumber; }
+
 
 protected:
 
@@ -118,6 +118,57 @@ const LineParser::OpcodeData	LineParser::m_gaOpcodeTable[] =
 #undef X
 
 
+/*************************************************************************************************/
+/**
+	LineParser::OpcodeIndex::OpcodeIndex()
+
+	Builds a direct lookup from 3-letter mnemonic to opcode table entry for each CPU type, so that
+	recognising an instruction takes a single probe instead of a scan of the opcode table
+*/
+/*************************************************************************************************/
+LineParser::OpcodeIndex::OpcodeIndex()
+{
+	for ( int cpu = 0; cpu < NUM_CPUS; cpu++ )
+	{
+		for ( int i = 0; i < NUM_MNEMONICS; i++ )
+		{
+			m_aInstructions[ cpu ][ i ] = -1;
+		}
+
+		// Walk the table backwards so that, as before, the first matching entry takes priority
+
+		for ( int i = static_cast<int>( sizeof m_gaOpcodeTable / sizeof( OpcodeData ) ) - 1; i >= 0; i-- )
+		{
+			const char* token = m_gaOpcodeTable[ i ].m_pName;
+
+			assert( strlen( token ) == 3 );
+
+			if ( m_gaOpcodeTable[ i ].m_cpu <= cpu )
+			{
+				int mnemonic = ( ( token[ 0 ] - 'A' ) * 26 + ( token[ 1 ] - 'A' ) ) * 26 + ( token[ 2 ] - 'A' );
+				m_aInstructions[ cpu ][ mnemonic ] = static_cast<short>( i );
+			}
+		}
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::GetOpcodeIndex()
+
+	Returns the mnemonic lookup tables, building them the first time they are needed
+*/
+/*************************************************************************************************/
+const LineParser::OpcodeIndex& LineParser::GetOpcodeIndex()
+{
+	static const OpcodeIndex index;
+	return index;
+}
+
+
+
 /*************************************************************************************************/
 /**
 	LineParser::GetInstructionAndAdvanceColumn()
@@ -134,51 +185,56 @@ const LineParser::OpcodeData	LineParser::m_gaOpcodeTable[] =
 /*************************************************************************************************/
 int LineParser::GetInstructionAndAdvanceColumn()
 {
-	for ( int i = 0; i < static_cast<int>( sizeof m_gaOpcodeTable / sizeof( OpcodeData ) ); i++ )
+	const size_t len = 3;
+
+	if ( m_column + len > m_line.length() )
 	{
-		int			cpu		= m_gaOpcodeTable[ i ].m_cpu;
-		const char*	token	= m_gaOpcodeTable[ i ].m_pName;
-		size_t		len		= strlen( token );
+		return -1;
+	}
 
-		// ignore instructions not for current cpu
-		if ( cpu > ObjectCode::Instance().GetCPU() )
-			continue;
+	// see if the next three characters are letters, and so could be a mnemonic
 
-		// see if token matches
+	int mnemonic = 0;
 
-		bool bMatch = true;
-		for ( unsigned int j = 0; j < len; j++ )
+	for ( unsigned int j = 0; j < len; j++ )
+	{
+		int c = toupper( static_cast<unsigned char>( m_line[ m_column + j ] ) );
+
+		if ( c < 'A' || c > 'Z' )
 		{
-			if ( token[ j ] != toupper( m_line[ m_column + j ] ) )
-			{
-				bMatch = false;
-				break;
-			}
+			return -1;
 		}
 
-		// The token matches so far, but (optionally) check there's nothing after it; this prevents 
-		// false matches where a macro name begins with an opcode, at the cost of disallowing 
-		// things like "foo=&70:stafoo".
-		if ( GlobalData::Instance().RequireDistinctOpcodes() && bMatch )
+		mnemonic = mnemonic * 26 + ( c - 'A' );
+	}
+
+	int cpu = ObjectCode::Instance().GetCPU();
+	assert( cpu >= 0 && cpu < OpcodeIndex::NUM_CPUS );
+
+	int i = GetOpcodeIndex().m_aInstructions[ cpu ][ mnemonic ];
+
+	if ( i == -1 )
+	{
+		return -1;
+	}
+
+	// The token matches so far, but (optionally) check there's nothing after it; this prevents 
+	// false matches where a macro name begins with an opcode, at the cost of disallowing 
+	// things like "foo=&70:stafoo".
+	if ( GlobalData::Instance().RequireDistinctOpcodes() )
+	{
+		std::string::size_type k = m_column + len;
+		if ( k < m_line.length() )
 		{
-			std::string::size_type k = m_column + len;
-			if ( k < m_line.length() )
+			if ( isalpha( m_line[ k ] ) || m_line[ k ] == '_' )
 			{
-				if ( isalpha( m_line[ k ] ) || m_line[ k ] == '_' )
-				{
-					bMatch = false;
-				}
+				return -1;
 			}
 		}
-
-		if ( bMatch )
-		{
-			m_column += len;
-			return i;
-		}
 	}
 
-	return -1;
+	m_column += len;
+	return i;
 }
 
 
@@ -309,6 +365,14 @@ void LineParser::Assemble2( int instructionIndex, ADDRESSING_MODE mode, unsigned
 		cout << endl << nouppercase << dec << setfill( ' ' );
 	}
 
+	if ( m_pDeferredExpression != NULL )
+	{
+		// Single pass mode: the operand is a placeholder for a symbol which isn't defined yet
+
+		assert( mode != IMP && mode != ACC );
+		AddFixup( ( mode == IMM ) ? SinglePass::IMMEDIATE : ( mode == REL ) ? SinglePass::RELATIVE : SinglePass::ZERO_PAGE );
+	}
+
 	try
 	{
 		ObjectCode::Instance().Assemble2( GetOpcode( instructionIndex, mode ), value );
@@ -369,6 +433,27 @@ void LineParser::Assemble3( int instructionIndex, ADDRESSING_MODE mode, unsigned
 		cout << endl << nouppercase << dec << setfill( ' ' );
 	}
 
+	if ( m_pDeferredExpression != NULL )
+	{
+		// Single pass mode: as in Assemble2().  If a zero page version of the instruction exists,
+		// the symbol must not turn out to be in zero page, as the second pass would have used it.
+
+		ADDRESSING_MODE zeroPageMode = ( mode == ABS ) ? ZP : ( mode == ABSX ) ? ZPX : ( mode == ABSY ) ? ZPY : IMP;
+
+		if ( mode == IND16 )
+		{
+			AddFixup( SinglePass::INDIRECT );
+		}
+		else if ( zeroPageMode != IMP && HasAddressingMode( instructionIndex, zeroPageMode ) )
+		{
+			AddFixup( SinglePass::ABSOLUTE_NOT_ZERO_PAGE );
+		}
+		else
+		{
+			AddFixup( SinglePass::ABSOLUTE );
+		}
+	}
+
 	try
 	{
 		ObjectCode::Instance().Assemble3( GetOpcode( instructionIndex, mode ), value );
@@ -430,7 +515,7 @@ void LineParser::HandleAssembler( int instruction )
 		}
 		catch ( AsmException_SyntaxError_SymbolNotDefined& )
 		{
-			if ( GlobalData::Instance().IsFirstPass() )
+			if ( GlobalData::Instance().IsFirstPass() || m_pDeferredExpression != NULL )
 			{
 				value = 0;
 			}
@@ -504,7 +589,7 @@ void LineParser::HandleAssembler( int instruction )
 		}
 		catch ( AsmException_SyntaxError_SymbolNotDefined& )
 		{
-			if ( GlobalData::Instance().IsFirstPass() )
+			if ( GlobalData::Instance().IsFirstPass() || m_pDeferredExpression != NULL )
 			{
 				value = 0;
 			}
@@ -726,7 +811,7 @@ void LineParser::HandleAssembler( int instruction )
 	}
 	catch ( AsmException_SyntaxError_SymbolNotDefined& )
 	{
-		if ( GlobalData::Instance().IsFirstPass() )
+		if ( GlobalData::Instance().IsFirstPass() || m_pDeferredExpression != NULL )
 		{
 			// this allows branches to assemble when the value is unknown due to a label not having
 			// yet been defined.  Also, this is most likely a 16-bit value, which is a sensible
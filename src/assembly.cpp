@@ -0,0 +1,196 @@
+/*************************************************************************************************/
+/**
+	assembly.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <iostream>
+#include <sstream>
+
+#include "assembly.h"
+#include "asmexception.h"
+#include "discimage.h"
+#include "globaldata.h"
+#include "macro.h"
+#include "objectcode.h"
+#include "random.h"
+#include "singlepass.h"
+#include "sourcefile.h"
+#include "instrumentation.h"
+#include "symboltable.h"
+
+
+using namespace std;
+
+
+
+/*************************************************************************************************/
+/**
+	AssembleSinglePass()
+
+	Tries to assemble the source in a single pass, deferring forward references as fixups.  PRINT
+	output is held back until the pass has succeeded, so nothing is printed twice if the source
+	then has to be assembled in two passes.
+
+	@param		pInputFile		Source filename
+	@param		randomSeed		Seed for RND()
+
+	@return		bool			false if the source must be assembled in two passes instead
+*/
+/*************************************************************************************************/
+static bool AssembleSinglePass( const char* pInputFile, time_t randomSeed )
+{
+	ostringstream output;
+	ostream& printStream = GlobalData::Instance().GetPrintStream();
+	GlobalData::Instance().SetPrintStream( &output );
+
+	SinglePass::Create();
+	GlobalData::Instance().SetSinglePass( true );
+
+	bool bSucceeded = true;
+
+	Instrumentation::BeginPass( "single pass" );
+
+	try
+	{
+		// Run as the second pass, so that all errors are checked for and output is generated
+
+		GlobalData::Instance().SetPass( 1 );
+		ObjectCode::Instance().InitialisePass();
+		GlobalData::Instance().ResetForId();
+		beebasm_srand( static_cast< unsigned long >( randomSeed ) );
+		SourceFile input( pInputFile );
+		input.Process();
+
+		SinglePass::Instance().ResolveFixups( 0, 0x10000 );
+	}
+	catch ( AsmException& )
+	{
+		bSucceeded = false;
+	}
+
+	Instrumentation::EndPass();
+
+	GlobalData::Instance().SetSinglePass( false );
+	SinglePass::Destroy();
+
+	GlobalData::Instance().SetPrintStream( &printStream );
+
+	if ( bSucceeded )
+	{
+		printStream << output.str();
+	}
+
+	return bSucceeded;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Assemble()
+
+	Assembles the source in the current AssemblyContext, writing the files it saves
+
+	@param		options			What to assemble, and how
+	@param		errors			Stream to report any error to
+
+	@return		bool			true if the source assembled without error
+*/
+/*************************************************************************************************/
+bool Assemble( const AssemblyOptions& options, ostream& errors )
+{
+	DiscImage* pDiscIm = NULL;
+	string discOutputPath;
+	bool bSucceeded = true;
+
+	if ( options.m_pDiscOutputFile != NULL )
+	{
+		discOutputPath = GlobalData::Instance().GetOutputPath( options.m_pDiscOutputFile );
+	}
+
+	try
+	{
+		if ( GlobalData::Instance().UsesDiscImage() )
+		{
+			pDiscIm = new DiscImage( discOutputPath.c_str(), options.m_pDiscInputFile );
+			GlobalData::Instance().SetDiscImage( pDiscIm );
+		}
+
+		// Single pass mode isn't used with -v, as the listing would show placeholder operands
+
+		bool bAssembled = false;
+
+		if ( options.m_bSinglePass && !GlobalData::Instance().IsVerbose() )
+		{
+			bAssembled = AssembleSinglePass( options.m_pInputFile, options.m_randomSeed );
+
+			if ( !bAssembled )
+			{
+				// Start again from scratch
+
+				MacroTable::Destroy();
+				ObjectCode::Destroy();
+				SymbolTable::Destroy();
+
+				SymbolTable::Create();
+				for ( vector< string >::const_iterator it = options.m_symbols.begin(); it != options.m_symbols.end(); ++it )
+				{
+					SymbolTable::Instance().AddCommandLineSymbol( *it );
+				}
+				ObjectCode::Create();
+				MacroTable::Create();
+
+				GlobalData::Instance().ResetSaved();
+
+				if ( pDiscIm != NULL )
+				{
+					delete pDiscIm;
+					pDiscIm = NULL;
+					pDiscIm = new DiscImage( discOutputPath.c_str(), options.m_pDiscInputFile );
+					GlobalData::Instance().SetDiscImage( pDiscIm );
+				}
+			}
+		}
+
+		for ( int pass = 0; !bAssembled && pass < 2; pass++ )
+		{
+			Instrumentation::BeginPass( ( pass == 0 ) ? "pass 1" : "pass 2" );
+
+			GlobalData::Instance().SetPass( pass );
+			ObjectCode::Instance().InitialisePass();
+			GlobalData::Instance().ResetForId();
+			beebasm_srand( static_cast< unsigned long >( options.m_randomSeed ) );
+			SourceFile input( options.m_pInputFile );
+			input.Process();
+		}
+	}
+	catch ( AsmException& e )
+	{
+		e.Print( errors );
+		bSucceeded = false;
+	}
+
+	Instrumentation::EndPass();
+
+	delete pDiscIm;
+	GlobalData::Instance().SetDiscImage( NULL );
+
+	return bSucceeded;
+}
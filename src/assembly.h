@@ -0,0 +1,57 @@
+/*************************************************************************************************/
+/**
+	assembly.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef ASSEMBLY_H_
+#define ASSEMBLY_H_
+
+#include <cstdlib>
+#include <ctime>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+
+struct AssemblyOptions
+{
+	AssemblyOptions()
+		:	m_pInputFile( NULL ),
+			m_pDiscInputFile( NULL ),
+			m_pDiscOutputFile( NULL ),
+			m_bSinglePass( false ),
+			m_randomSeed( 0 )
+	{
+	}
+
+	const char*					m_pInputFile;
+	const char*					m_pDiscInputFile;
+	const char*					m_pDiscOutputFile;
+	std::vector< std::string >	m_symbols;			// as for -D, already in the symbol table
+	bool						m_bSinglePass;
+	time_t						m_randomSeed;
+};
+
+
+bool Assemble( const AssemblyOptions& options, std::ostream& errors );
+
+
+
+#endif // ASSEMBLY_H_
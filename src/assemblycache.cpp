@@ -0,0 +1,410 @@
+/*************************************************************************************************/
+/**
+	assemblycache.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "assemblycache.h"
+#include "globaldata.h"
+#include "sha256.h"
+
+
+using namespace std;
+
+
+static const char* MANIFEST_HEADER = "beebasm-cache 2";
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyCache::AssemblyCache()
+
+	AssemblyCache constructor
+
+	@param		pDirectory		Directory holding the cache, created when first stored to
+	@param		options			Everything on the command line which affects the result
+*/
+/*************************************************************************************************/
+AssemblyCache::AssemblyCache( const char* pDirectory, const vector< string >& options )
+	:	m_directory( pDirectory )
+{
+	string keyText;
+
+	for ( vector< string >::const_iterator it = options.begin(); it != options.end(); ++it )
+	{
+		keyText += *it;
+		keyText += '\0';
+	}
+
+	m_key = HashText( keyText );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyCache::Restore()
+
+	Looks up the result of assembling with these options.  It is only used if every file the
+	assembly read is unchanged and everything it wrote is still held; if so, the files are written
+	again and recorded in GlobalData as though they had just been assembled.
+
+	@param		output			Returns the text which the assembly printed
+
+	@return		bool			false if the assembly must be run
+*/
+/*************************************************************************************************/
+bool AssemblyCache::Restore( string& output ) const
+{
+	string manifest;
+
+	if ( !ReadFile( GetManifestPath(), manifest ) )
+	{
+		return false;
+	}
+
+	istringstream lines( manifest );
+	string line;
+
+	if ( !getline( lines, line ) || line != MANIFEST_HEADER )
+	{
+		return false;
+	}
+
+	bool bSaved = false;
+	vector< string > inputs;
+	vector< pair< string, string > > outputs;
+
+	while ( getline( lines, line ) )
+	{
+		istringstream fields( line );
+		string type;
+		string hash;
+		string filename;
+
+		fields >> type >> hash;
+		getline( fields >> ws, filename );
+
+		string contents;
+
+		if ( type == "saved" )
+		{
+			bSaved = ( hash == "1" );
+		}
+		else if ( type == "stdout" )
+		{
+			if ( !ReadFile( GetObjectPath( hash ), output ) || HashText( output ) != hash )
+			{
+				return false;
+			}
+		}
+		else if ( type == "input" )
+		{
+			if ( !ReadFile( filename, contents ) || HashText( contents ) != hash )
+			{
+				return false;
+			}
+			inputs.push_back( filename );
+		}
+		else if ( type == "output" )
+		{
+			if ( !ReadFile( GetObjectPath( hash ), contents ) || HashText( contents ) != hash )
+			{
+				return false;
+			}
+			outputs.push_back( make_pair( filename, contents ) );
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	for ( vector< pair< string, string > >::const_iterator it = outputs.begin(); it != outputs.end(); ++it )
+	{
+		if ( !WriteFile( it->first, it->second ) )
+		{
+			return false;
+		}
+	}
+
+	for ( vector< string >::const_iterator it = inputs.begin(); it != inputs.end(); ++it )
+	{
+		GlobalData::Instance().AddInputFile( *it );
+	}
+
+	for ( vector< pair< string, string > >::const_iterator it = outputs.begin(); it != outputs.end(); ++it )
+	{
+		GlobalData::Instance().AddOutputFile( it->first );
+	}
+
+	if ( bSaved )
+	{
+		GlobalData::Instance().SetSaved();
+	}
+
+	return true;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyCache::Store()
+
+	Stores the result of a successful assembly, using the files recorded in GlobalData.  Failing
+	to write to the cache isn't an error; the result just won't be found next time.
+
+	@param		output			The text which the assembly printed
+*/
+/*************************************************************************************************/
+void AssemblyCache::Store( const string& output ) const
+{
+#ifdef _WIN32
+	_mkdir( m_directory.c_str() );
+#else
+	mkdir( m_directory.c_str(), 0777 );
+#endif
+
+	ostringstream manifest;
+	string hash;
+	string contents;
+
+	manifest << MANIFEST_HEADER << endl;
+	manifest << "saved " << ( GlobalData::Instance().IsSaved() ? 1 : 0 ) << endl;
+
+	if ( !StoreObject( output, hash ) )
+	{
+		return;
+	}
+
+	manifest << "stdout " << hash << endl;
+
+	const vector< string >& inputs = GlobalData::Instance().GetInputFiles();
+
+	for ( vector< string >::const_iterator it = inputs.begin(); it != inputs.end(); ++it )
+	{
+		if ( !ReadFile( *it, contents ) )
+		{
+			return;
+		}
+		manifest << "input " << HashText( contents ) << " " << *it << endl;
+	}
+
+	const vector< string >& outputs = GlobalData::Instance().GetOutputFiles();
+
+	for ( vector< string >::const_iterator it = outputs.begin(); it != outputs.end(); ++it )
+	{
+		if ( !ReadFile( *it, contents ) || !StoreObject( contents, hash ) )
+		{
+			return;
+		}
+		manifest << "output " << hash << " " << *it << endl;
+	}
+
+	WriteFile( GetManifestPath(), manifest.str() );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyCache::HashText()
+
+	Hashes a block of text or binary data.  The result is used both to check that files are
+	unchanged and to address stored data, so it is the SHA-256 hash followed by the size, making a
+	mismatch from a collision as unlikely as can be.
+
+	@param		text			Data to hash
+
+	@return		string			The hash as 64 hex digits, then '-' and the size in bytes
+*/
+/*************************************************************************************************/
+string AssemblyCache::HashText( const string& text )
+{
+	ostringstream hash;
+	hash << Sha256::HashToHex( text ) << "-" << text.length();
+	return hash.str();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyCache::ReadFile()
+
+	Reads the whole of a file
+
+	@param		filename		File to read
+	@param		contents		Returns the contents of the file
+
+	@return		bool			false if the file couldn't be read
+*/
+/*************************************************************************************************/
+bool AssemblyCache::ReadFile( const string& filename, string& contents )
+{
+	ifstream file( filename.c_str(), ios_base::in | ios_base::binary );
+
+	if ( !file )
+	{
+		return false;
+	}
+
+	ostringstream buffer;
+	buffer << file.rdbuf();
+	contents = buffer.str();
+
+	return !file.bad();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyCache::WriteFile()
+
+	Writes a file by writing a temporary file alongside it and renaming it, so that a file which is
+	only partly written is never seen under the real name.  The temporary name is unique to this
+	process and call, as other processes may be storing to the same cache at the same time.
+
+	@param		filename		File to write
+	@param		contents		Data to write
+
+	@return		bool			false if the file couldn't be written
+*/
+/*************************************************************************************************/
+bool AssemblyCache::WriteFile( const string& filename, const string& contents )
+{
+	static atomic< unsigned int > tempCount( 0 );
+
+#ifdef _WIN32
+	int pid = _getpid();
+#else
+	int pid = static_cast< int >( getpid() );
+#endif
+
+	ostringstream tempName;
+	tempName << filename << "." << pid << "." << tempCount++ << ".tmp";
+
+	string tempFilename = tempName.str();
+	ofstream file( tempFilename.c_str(), ios_base::out | ios_base::binary | ios_base::trunc );
+
+	file.write( contents.data(), contents.size() );
+	file.close();
+
+	if ( file.fail() )
+	{
+		remove( tempFilename.c_str() );
+		return false;
+	}
+
+	if ( rename( tempFilename.c_str(), filename.c_str() ) != 0 )
+	{
+#ifdef _WIN32
+		// On Windows, rename won't replace an existing file.  Elsewhere it replaces it atomically,
+		// so a failure is real, and removing the file could lose one which another process has
+		// just stored.
+
+		remove( filename.c_str() );
+
+		if ( rename( tempFilename.c_str(), filename.c_str() ) == 0 )
+		{
+			return true;
+		}
+#endif
+
+		remove( tempFilename.c_str() );
+		return false;
+	}
+
+	return true;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyCache::GetManifestPath()
+
+	@return		string			Path of the manifest for these options
+*/
+/*************************************************************************************************/
+string AssemblyCache::GetManifestPath() const
+{
+	return m_directory + "/" + m_key + ".manifest";
+}
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyCache::GetObjectPath()
+
+	@param		hash			Hash of the stored data
+
+	@return		string			Path under which the data is stored
+*/
+/*************************************************************************************************/
+string AssemblyCache::GetObjectPath( const string& hash ) const
+{
+	return m_directory + "/" + hash;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyCache::StoreObject()
+
+	Stores data under its hash, unless it is already held
+
+	@param		contents		Data to store
+	@param		hash			Returns the hash of the data
+
+	@return		bool			false if the data couldn't be stored
+*/
+/*************************************************************************************************/
+bool AssemblyCache::StoreObject( const string& contents, string& hash ) const
+{
+	hash = HashText( contents );
+
+	string path = GetObjectPath( hash );
+
+	if ( ifstream( path.c_str() ) )
+	{
+		return true;
+	}
+
+	return WriteFile( path, contents );
+}
@@ -0,0 +1,60 @@
+/*************************************************************************************************/
+/**
+	assemblycache.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef ASSEMBLYCACHE_H_
+#define ASSEMBLYCACHE_H_
+
+#include <string>
+#include <vector>
+
+
+// Content-addressed store of assembly results.  Each set of command line options has a manifest
+// naming the files which the assembly read and wrote, with a hash of the contents of each.  The
+// files written, and the text printed, are stored once each under their hash.
+
+class AssemblyCache
+{
+public:
+
+	AssemblyCache( const char* pDirectory, const std::vector< std::string >& options );
+
+	bool Restore( std::string& output ) const;
+	void Store( const std::string& output ) const;
+
+
+private:
+
+	static std::string HashText( const std::string& text );
+	static bool ReadFile( const std::string& filename, std::string& contents );
+	static bool WriteFile( const std::string& filename, const std::string& contents );
+
+	std::string GetManifestPath() const;
+	std::string GetObjectPath( const std::string& hash ) const;
+	bool StoreObject( const std::string& contents, std::string& hash ) const;
+
+	std::string					m_directory;
+	std::string					m_key;
+};
+
+
+
+#endif // ASSEMBLYCACHE_H_
@@ -0,0 +1,108 @@
+/*************************************************************************************************/
+/**
+	assemblycontext.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include "assemblycontext.h"
+#include "globaldata.h"
+#include "symboltable.h"
+#include "objectcode.h"
+#include "linecache.h"
+#include "macro.h"
+#include "singlepass.h"
+#include "statistics.h"
+#include "profiler.h"
+#include "tracer.h"
+
+
+BEEBASM_THREAD_LOCAL AssemblyContext* AssemblyContext::m_pCurrent = NULL;
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyContext::AssemblyContext()
+
+	AssemblyContext constructor; creates the state for a new assembly and makes it current
+*/
+/*************************************************************************************************/
+AssemblyContext::AssemblyContext()
+	:	m_pPrevious( m_pCurrent ),
+		m_pGlobalData( NULL ),
+		m_pSymbolTable( NULL ),
+		m_pObjectCode( NULL ),
+		m_pLineCache( NULL ),
+		m_pMacroTable( NULL ),
+		m_pSinglePass( NULL ),
+		m_pStatistics( NULL ),
+		m_pProfiler( NULL ),
+		m_pTracer( NULL ),
+		m_randomState( 19670512 )
+{
+	m_pCurrent = this;
+
+	GlobalData::Create();
+	SymbolTable::Create();
+	ObjectCode::Create();
+	LineCache::Create();
+	MacroTable::Create();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	AssemblyContext::~AssemblyContext()
+
+	AssemblyContext destructor; destroys the state and makes the previous context current again
+*/
+/*************************************************************************************************/
+AssemblyContext::~AssemblyContext()
+{
+	assert( m_pCurrent == this );
+
+	if ( m_pSinglePass != NULL )
+	{
+		SinglePass::Destroy();
+	}
+
+	if ( m_pStatistics != NULL )
+	{
+		Statistics::Destroy();
+	}
+
+	if ( m_pProfiler != NULL )
+	{
+		Profiler::Destroy();
+	}
+
+	if ( m_pTracer != NULL )
+	{
+		Tracer::Destroy();
+	}
+
+	MacroTable::Destroy();
+	LineCache::Destroy();
+	ObjectCode::Destroy();
+	SymbolTable::Destroy();
+	GlobalData::Destroy();
+
+	m_pCurrent = m_pPrevious;
+}
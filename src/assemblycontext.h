@@ -0,0 +1,102 @@
+/*************************************************************************************************/
+/**
+	assemblycontext.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef ASSEMBLYCONTEXT_H_
+#define ASSEMBLYCONTEXT_H_
+
+#include <cassert>
+#include <cstdlib>
+#include <vector>
+
+
+#if defined( _MSC_VER )
+#define BEEBASM_THREAD_LOCAL __declspec( thread )
+#else
+#define BEEBASM_THREAD_LOCAL __thread
+#endif
+
+
+class GlobalData;
+class SymbolTable;
+class ObjectCode;
+class LineCache;
+class MacroTable;
+class SinglePass;
+class Statistics;
+class Profiler;
+class Tracer;
+class Instrument;
+
+
+// All of the state belonging to one assembly.  The state classes are still reached through their
+// Instance() functions, which return the ones belonging to the calling thread's current context,
+// so separate contexts can assemble in parallel on separate threads.
+//
+// A context is current on the thread which constructs it until it is destroyed, which must happen
+// on the same thread.  SetupBASICTables() must be called once before any threads are started.
+
+class AssemblyContext
+{
+public:
+
+	AssemblyContext();
+	~AssemblyContext();
+
+	static inline AssemblyContext& Current() { assert( m_pCurrent != NULL ); return *m_pCurrent; }
+
+	inline unsigned long GetRandomState() const		{ return m_randomState; }
+	inline void SetRandomState( unsigned long s )	{ m_randomState = s; }
+
+
+private:
+
+	friend class GlobalData;
+	friend class SymbolTable;
+	friend class ObjectCode;
+	friend class LineCache;
+	friend class MacroTable;
+	friend class SinglePass;
+	friend class Statistics;
+	friend class Profiler;
+	friend class Tracer;
+	friend class Instrumentation;
+
+	static BEEBASM_THREAD_LOCAL AssemblyContext*	m_pCurrent;
+
+	AssemblyContext*			m_pPrevious;		// context which was current before this one
+
+	GlobalData*					m_pGlobalData;
+	SymbolTable*				m_pSymbolTable;
+	ObjectCode*					m_pObjectCode;
+	LineCache*					m_pLineCache;
+	MacroTable*					m_pMacroTable;
+	SinglePass*					m_pSinglePass;
+	Statistics*					m_pStatistics;
+	Profiler*					m_pProfiler;
+	Tracer*						m_pTracer;
+	std::vector< Instrument* >	m_instruments;		// the statistics, profiler and tracer, if created
+	unsigned long				m_randomState;
+};
+
+
+
+#endif // ASSEMBLYCONTEXT_H_
@@ -25,6 +25,7 @@
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <vector>
 #include <cstring>
 #include <ctime>
 
@@ -35,8 +36,11 @@
 #include "sourcefile.h"
 #include "asmexception.h"
 #include "discimage.h"
+#include "virtualfiles.h"
 #include "BASIC.h"
 #include "random.h"
+#include "singlepass.h"
+#include "instrumentation.h"
 
 
 using namespace std;
@@ -85,6 +89,59 @@ const LineParser::Token	LineParser::m_gaTokenTable[] =
 
 
 
+/*************************************************************************************************/
+/**
+	LineParser::TokenIndex::TokenIndex()
+
+	Indexes the token table by first character, so that a token lookup only has to consider the
+	handful of tokens which could possibly match.  Tokens keep their table order within each
+	group, as that determines priority (e.g. SKIPTO must be tried before SKIP).
+*/
+/*************************************************************************************************/
+LineParser::TokenIndex::TokenIndex()
+{
+	const int numTokens = static_cast<int>( sizeof m_gaTokenTable / sizeof( Token ) );
+
+	m_lengths.resize( numTokens );
+
+	for ( int i = 0; i < numTokens; i++ )
+	{
+		m_lengths[ i ] = strlen( m_gaTokenTable[ i ].m_pName );
+	}
+
+	for ( int c = 0; c < 256; c++ )
+	{
+		m_aFirst[ c ] = static_cast<int>( m_tokens.size() );
+
+		for ( int i = 0; i < numTokens; i++ )
+		{
+			if ( static_cast<unsigned char>( m_gaTokenTable[ i ].m_pName[ 0 ] ) == c )
+			{
+				m_tokens.push_back( i );
+			}
+		}
+	}
+
+	m_aFirst[ 256 ] = static_cast<int>( m_tokens.size() );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::GetTokenIndex()
+
+	Returns the token table index, building it the first time it is needed
+*/
+/*************************************************************************************************/
+const LineParser::TokenIndex& LineParser::GetTokenIndex()
+{
+	static const TokenIndex index;
+	return index;
+}
+
+
+
 /*************************************************************************************************/
 /**
 	LineParser::GetTokenAndAdvanceColumn()
@@ -101,15 +158,29 @@ const LineParser::Token	LineParser::m_gaTokenTable[] =
 /*************************************************************************************************/
 int LineParser::GetTokenAndAdvanceColumn()
 {
-	for ( int i = 0; i < static_cast<int>( sizeof m_gaTokenTable / sizeof( Token ) ); i++ )
+	if ( m_column >= m_line.length() )
+	{
+		return -1;
+	}
+
+	const TokenIndex& index = GetTokenIndex();
+	int first = toupper( static_cast<unsigned char>( m_line[ m_column ] ) );
+
+	for ( int t = index.m_aFirst[ first ]; t < index.m_aFirst[ first + 1 ]; t++ )
 	{
+		int			i		= index.m_tokens[ t ];
 		const char*	token	= m_gaTokenTable[ i ].m_pName;
-		size_t		len		= strlen( token );
+		size_t		len		= index.m_lengths[ i ];
+
+		if ( m_column + len > m_line.length() )
+		{
+			continue;
+		}
 
-		// see if token matches
+		// see if token matches (we already know that the first character does)
 
 		bool bMatch = true;
-		for ( unsigned int j = 0; j < len; j++ )
+		for ( unsigned int j = 1; j < len; j++ )
 		{
 			if ( token[ j ] != toupper( m_line[ m_column + j ] ) )
 			{
@@ -182,28 +253,35 @@ void LineParser::HandleDefineLabel()
 
 		string symbolName = GetSymbolName();
 
-		// ...and mangle it according to whether we are in a FOR loop
+		// ...and put it in the scope of the appropriate FOR loop level
 
-		string fullSymbolName = symbolName + m_sourceCode->GetSymbolNameSuffix( target_level );
+		int scope = m_sourceCode->GetDefinitionScope( target_level );
 
-		if ( GlobalData::Instance().IsFirstPass() )
+		int symbol = SymbolTable::Instance().FindSymbol( scope, symbolName );
+
+		if ( GlobalData::Instance().IsDefiningPass() )
 		{
 			// only add the symbol on the first pass
 
-			if ( SymbolTable::Instance().IsSymbolDefined( fullSymbolName ) )
+			if ( symbol != -1 )
 			{
 				throw AsmException_SyntaxError_LabelAlreadyDefined( m_line, oldColumn );
 			}
 			else
 			{
-				SymbolTable::Instance().AddSymbol( fullSymbolName, ObjectCode::Instance().GetPC(), true );
+				if ( GlobalData::Instance().IsSinglePass() )
+				{
+					SinglePass::Instance().CheckDefinition( scope, symbolName );
+				}
+
+				SymbolTable::Instance().AddSymbol( scope, symbolName, ObjectCode::Instance().GetPC(), true );
 			}
 		}
 		else
 		{
 			// on the second pass, check that the label would be assigned the same value
 
-			if ( SymbolTable::Instance().GetSymbol( fullSymbolName ) != ObjectCode::Instance().GetPC() )
+			if ( SymbolTable::Instance().GetSymbolValue( symbol ) != ObjectCode::Instance().GetPC() )
 			{
 				throw AsmException_SyntaxError_SecondPassProblem( m_line, oldColumn );
 			}
@@ -278,7 +356,6 @@ void LineParser::HandleOrg()
 	}
 
 	ObjectCode::Instance().SetPC( newPC );
-	SymbolTable::Instance().ChangeSymbol( "P%", newPC );
 
 	if ( m_column < m_line.length() && m_line[ m_column ] == ',' )
 	{
@@ -364,6 +441,11 @@ void LineParser::HandleClear()
 		throw AsmException_SyntaxError_OutOfRange( m_line, m_column );
 	}
 
+	if ( GlobalData::Instance().IsSinglePass() )
+	{
+		SinglePass::Instance().ResolveFixups( start, end );
+	}
+
 	ObjectCode::Instance().Clear( start, end );
 
 	if ( m_column < m_line.length() && m_line[ m_column ] == ',' )
@@ -468,18 +550,15 @@ void LineParser::HandleAlign()
 		throw AsmException_SyntaxError_BadAlignment( m_line, oldColumn );
 	}
 
-	while ( ( ObjectCode::Instance().GetPC() & ( val - 1 ) ) != 0 )
+	try
 	{
-		try
-		{
-			ObjectCode::Instance().PutByte( 0 );
-		}
-		catch ( AsmException_AssembleError& e )
-		{
-			e.SetString( m_line );
-			e.SetColumn( m_column );
-			throw;
-		}
+		ObjectCode::Instance().ReserveRange( -ObjectCode::Instance().GetPC() & ( val - 1 ) );
+	}
+	catch ( AsmException_AssembleError& e )
+	{
+		e.SetString( m_line );
+		e.SetColumn( m_column );
+		throw;
 	}
 
 	if ( m_column < m_line.length() && m_line[ m_column ] == ',' )
@@ -512,18 +591,15 @@ void LineParser::HandleSkip()
 		cout << setw(4) << ObjectCode::Instance().GetPC() << endl;
 	}
 
-	for ( int i = 0; i < val; i++ )
+	try
 	{
-		try
-		{
-			ObjectCode::Instance().PutByte( 0 );
-		}
-		catch ( AsmException_AssembleError& e )
-		{
-			e.SetString( m_line );
-			e.SetColumn( m_column );
-			throw;
-		}
+		ObjectCode::Instance().ReserveRange( val );
+	}
+	catch ( AsmException_AssembleError& e )
+	{
+		e.SetString( m_line );
+		e.SetColumn( m_column );
+		throw;
 	}
 
 	if ( m_column < m_line.length() && m_line[ m_column ] == ',' )
@@ -555,18 +631,15 @@ void LineParser::HandleSkipTo()
 		throw AsmException_SyntaxError_BackwardsSkip( m_line, oldColumn );
 	}
 
-	while ( ObjectCode::Instance().GetPC() < addr )
+	try
 	{
-		try
-		{
-			ObjectCode::Instance().PutByte( 0 );
-		}
-		catch ( AsmException_AssembleError& e )
-		{
-			e.SetString( m_line );
-			e.SetColumn( m_column );
-			throw;
-		}
+		ObjectCode::Instance().ReserveRange( addr - ObjectCode::Instance().GetPC() );
+	}
+	catch ( AsmException_AssembleError& e )
+	{
+		e.SetString( m_line );
+		e.SetColumn( m_column );
+		throw;
 	}
 
 	if ( m_column < m_line.length() && m_line[ m_column ] == ',' )
@@ -669,6 +742,8 @@ void LineParser::HandleIncBin()
 			e.SetColumn( m_column );
 			throw;
 		}
+
+		GlobalData::Instance().AddInputFile( filename );
 	}
 
 	m_column = endQuotePos + 1;
@@ -730,10 +805,20 @@ void LineParser::HandleEqub()
 				m_column++;
 			}
 
+			GlobalData::Instance().SetNotRepeatable();
+
 			char timeString[256];
 			const time_t t = GlobalData::Instance().GetAssemblyTime();
-			const struct tm* t_tm = localtime( &t );
-			if ( strftime( timeString, sizeof( timeString ), format.c_str(), t_tm ) == 0 )
+
+			// -variants can assemble on several threads at once, so avoid localtime(), which returns a
+			// pointer to a static buffer shared between them
+			struct tm t_tm;
+#ifdef _WIN32
+			localtime_s( &t_tm, &t );
+#else
+			localtime_r( &t, &t_tm );
+#endif
+			if ( strftime( timeString, sizeof( timeString ), format.c_str(), &t_tm ) == 0 )
 			{
 				throw AsmException_SyntaxError_TimeResultTooBig( m_line, m_column );
 			}
@@ -770,7 +855,7 @@ void LineParser::HandleEqub()
 			}
 			catch ( AsmException_SyntaxError_SymbolNotDefined& )
 			{
-				if ( GlobalData::Instance().IsFirstPass() )
+				if ( GlobalData::Instance().IsFirstPass() || m_pDeferredExpression != NULL )
 				{
 					value = 0;
 				}
@@ -793,6 +878,11 @@ void LineParser::HandleEqub()
 				cout << endl << nouppercase << dec << setfill( ' ' );
 			}
 
+			if ( m_pDeferredExpression != NULL )
+			{
+				AddFixup( SinglePass::BYTE );
+			}
+
 			try
 			{
 				ObjectCode::Instance().PutByte( value & 0xFF );
@@ -835,9 +925,13 @@ void LineParser::HandleEqus( const string& equs )
 		cout << setw(4) << ObjectCode::Instance().GetPC() << "   ";
 	}
 
+	// remap characters from string as per character mapping table
+	vector< unsigned char > mapped( equs.length() );
+
 	for ( size_t i = 0; i < equs.length(); i++ )
 	{
 		int mappedchar = ObjectCode::Instance().GetMapping( equs[ i ] );
+		mapped[ i ] = static_cast< unsigned char >( mappedchar );
 
 		if ( GlobalData::Instance().ShouldOutputAsm() )
 		{
@@ -850,11 +944,13 @@ void LineParser::HandleEqus( const string& equs )
 				cout << "...";
 			}
 		}
+	}
 
+	if ( !mapped.empty() )
+	{
 		try
 		{
-			// remap character from string as per character mapping table
-			ObjectCode::Instance().PutByte( mappedchar );
+			ObjectCode::Instance().PutBytes( &mapped[ 0 ], static_cast< int >( mapped.size() ) );
 		}
 		catch ( AsmException_AssembleError& e )
 		{
@@ -889,7 +985,7 @@ void LineParser::HandleEquw()
 		}
 		catch ( AsmException_SyntaxError_SymbolNotDefined& )
 		{
-			if ( GlobalData::Instance().IsFirstPass() )
+			if ( GlobalData::Instance().IsFirstPass() || m_pDeferredExpression != NULL )
 			{
 				value = 0;
 			}
@@ -913,6 +1009,11 @@ void LineParser::HandleEquw()
 			cout << endl << nouppercase << dec << setfill( ' ' );
 		}
 
+		if ( m_pDeferredExpression != NULL )
+		{
+			AddFixup( SinglePass::WORD );
+		}
+
 		try
 		{
 			ObjectCode::Instance().PutByte( value & 0xFF );
@@ -964,7 +1065,7 @@ void LineParser::HandleEqud()
 		}
 		catch ( AsmException_SyntaxError_SymbolNotDefined& )
 		{
-			if ( GlobalData::Instance().IsFirstPass() )
+			if ( GlobalData::Instance().IsFirstPass() || m_pDeferredExpression != NULL )
 			{
 				value = 0;
 			}
@@ -985,6 +1086,11 @@ void LineParser::HandleEqud()
 			cout << endl << nouppercase << dec << setfill( ' ' );
 		}
 
+		if ( m_pDeferredExpression != NULL )
+		{
+			AddFixup( SinglePass::DWORD );
+		}
+
 		try
 		{
 			ObjectCode::Instance().PutByte( value & 0xFF );
@@ -1244,6 +1350,14 @@ void LineParser::HandleSave()
 
 	if ( GlobalData::Instance().IsSecondPass() )
 	{
+		InstrumentedWrite instrumentedWrite( "save", saveFile );
+
+		if ( GlobalData::Instance().IsSinglePass() )
+		{
+			// Fill in any forward references in the block before it's written
+			SinglePass::Instance().ResolveFixups( start, end );
+		}
+
 		if ( GlobalData::Instance().UsesDiscImage() )
 		{
 			// disc image version of the save
@@ -1253,24 +1367,36 @@ void LineParser::HandleSave()
 															exec,
 															end - start );
 		}
+		else if ( GlobalData::Instance().GetVirtualFiles() != NULL )
+		{
+			// in-memory version of the save
+			GlobalData::Instance().GetVirtualFiles()->AddFile( saveFile.c_str(),
+															   ObjectCode::Instance().GetAddr( start ),
+															   reload,
+															   exec,
+															   end - start );
+		}
 		else
 		{
 			// regular save
+			string savePath = GlobalData::Instance().GetOutputPath( saveFile );
 			ofstream objFile;
 
-			objFile.open( saveFile.c_str(), ios_base::out | ios_base::binary | ios_base::trunc );
+			objFile.open( savePath.c_str(), ios_base::out | ios_base::binary | ios_base::trunc );
 
 			if ( !objFile )
 			{
-				throw AsmException_FileError_OpenObj( saveFile.c_str() );
+				throw AsmException_FileError_OpenObj( savePath.c_str() );
 			}
 
 			if ( !objFile.write( reinterpret_cast< const char* >( ObjectCode::Instance().GetAddr( start ) ), end - start ) )
 			{
-				throw AsmException_FileError_WriteObj( saveFile.c_str() );
+				throw AsmException_FileError_WriteObj( savePath.c_str() );
 			}
 
 			objFile.close();
+
+			GlobalData::Instance().AddOutputFile( savePath );
 		}
 
 		GlobalData::Instance().SetSaved();
@@ -1304,11 +1430,11 @@ void LineParser::HandleFor()
 	// Symbol starts with a valid character
 
 	int oldColumn = m_column;
-	string symbolName = GetSymbolName() + m_sourceCode->GetSymbolNameSuffix();
+	string symbolName = GetSymbolName();
 
 	// Check variable has not yet been defined
 
-	if ( SymbolTable::Instance().IsSymbolDefined( symbolName ) )
+	if ( SymbolTable::Instance().IsSymbolDefined( m_sourceCode->GetDefinitionScope(), symbolName ) )
 	{
 		throw AsmException_SyntaxError_LabelAlreadyDefined( m_line, oldColumn );
 	}
@@ -1497,7 +1623,7 @@ void LineParser::HandlePrint()
 			{
 				if ( GlobalData::Instance().IsSecondPass() )
 				{
-					cout << m_line.substr( m_column + 1, endQuotePos - m_column - 1 ) << " ";
+					GlobalData::Instance().GetPrintStream() << m_line.substr( m_column + 1, endQuotePos - m_column - 1 ) << " ";
 				}
 			}
 
@@ -1529,7 +1655,7 @@ void LineParser::HandlePrint()
 
 			if ( GlobalData::Instance().IsSecondPass() )
 			{
-				cout << hex << uppercase << "&" << value << dec << nouppercase << " ";
+				GlobalData::Instance().GetPrintStream() << hex << uppercase << "&" << value << dec << nouppercase << " ";
 			}
 		}
 		else
@@ -1556,14 +1682,14 @@ void LineParser::HandlePrint()
 
 			if ( GlobalData::Instance().IsSecondPass() )
 			{
-				cout << value << " ";
+				GlobalData::Instance().GetPrintStream() << value << " ";
 			}
 		}
 	}
 
 	if ( GlobalData::Instance().IsSecondPass() )
 	{
-		cout << endl;
+		GlobalData::Instance().GetPrintStream() << endl;
 	}
 }
 
@@ -1726,7 +1852,20 @@ void LineParser::HandlePutFileCommon( bool bText )
 		throw AsmException_SyntaxError_InvalidCharacter( m_line, m_column );
 	}
 
-	if ( GlobalData::Instance().IsSecondPass() )
+	if ( GlobalData::Instance().IsSecondPass() &&
+		 GlobalData::Instance().GetVirtualFiles() != NULL )
+	{
+		// There's no disc image when assembling in memory, so just check that the file exists
+
+		if ( GlobalData::Instance().GetVirtualFiles()->Find( hostFilename ) == NULL )
+		{
+			AsmException_AssembleError_FileOpen e;
+			e.SetString( m_line );
+			e.SetColumn( m_column );
+			throw e;
+		}
+	}
+	else if ( GlobalData::Instance().IsSecondPass() )
 	{
 		ifstream inputFile;
 		inputFile.open( hostFilename.c_str(), ios_base::in | ios_base::binary );
@@ -1739,6 +1878,8 @@ void LineParser::HandlePutFileCommon( bool bText )
 			throw e;
 		}
 
+		GlobalData::Instance().AddInputFile( hostFilename );
+
 		inputFile.seekg( 0, ios_base::end );
 		size_t fileSize = static_cast< size_t >( inputFile.tellg() );
 		inputFile.seekg( 0, ios_base::beg );
@@ -1754,7 +1895,7 @@ void LineParser::HandlePutFileCommon( bool bText )
 				{
 					// swallow other half of CRLF/LFCR, if present
 					int other_half = ( c == '\n' ) ? '\r' : '\n';
-					ifstream::streampos p = inputFile.tellg();
+					ifstream::pos_type p = inputFile.tellg();
 					if ( inputFile.get() != other_half )
 					{
 						inputFile.seekg( p );
@@ -1886,6 +2027,8 @@ void LineParser::HandlePutBasic()
 			}
 		}
 
+		GlobalData::Instance().AddInputFile( hostFilename );
+
 		// disc image version of the save
 		GlobalData::Instance().GetDiscImage()->AddFile( beebFilename.c_str(),
 														reinterpret_cast< unsigned char* >( buffer ),
@@ -1917,7 +2060,7 @@ void LineParser::HandleMacro()
 	{
 		macroName = GetSymbolName();
 
-		if ( GlobalData::Instance().IsFirstPass() )
+		if ( GlobalData::Instance().IsDefiningPass() )
 		{
 			if ( MacroTable::Instance().Exists( macroName ) )
 			{
@@ -1953,7 +2096,7 @@ void LineParser::HandleMacro()
 		{
 			string param = GetSymbolName();
 
-			if ( GlobalData::Instance().IsFirstPass() )
+			if ( GlobalData::Instance().IsDefiningPass() )
 			{
 				m_sourceCode->GetCurrentMacro()->AddParameter( param );
 			}
@@ -1975,7 +2118,7 @@ void LineParser::HandleMacro()
 	// beginning of the macro definition, so any errors are reported on the correct line
 
 	if ( m_column == m_line.length() &&
-		 GlobalData::Instance().IsFirstPass() )
+		 GlobalData::Instance().IsDefiningPass() )
 	{
 		m_sourceCode->GetCurrentMacro()->AddLine("\n");
 	}
@@ -2089,7 +2232,13 @@ void LineParser::HandleCopyBlock()
 
 	if ( GlobalData::Instance().IsSecondPass() )
 	{
-		ObjectCode::Instance().CopyBlock( start, end, dest );
+		if ( GlobalData::Instance().IsSinglePass() )
+		{
+			// The first pass doesn't move the block, so memory must be checked in two passes
+			throw AsmException_SinglePassFailed();
+		}
+
+		ObjectCode::Instance().MoveRange( start, end, dest );
 	}
 
 	if ( m_column < m_line.length() && m_line[ m_column ] == ',' )
@@ -26,6 +26,7 @@
 #include "discimage.h"
 #include "asmexception.h"
 #include "globaldata.h"
+#include "instrumentation.h"
 
 using namespace std;
 
@@ -175,6 +176,8 @@ DiscImage::~DiscImage()
 /*************************************************************************************************/
 void DiscImage::AddFile( const char* pName, const unsigned char* pAddr, int load, int exec, int len )
 {
+	InstrumentedWrite instrumentedWrite( "disc", pName );
+
 	char dirName = '$';
 
 	if ( strlen( pName ) > 2 && pName[ 1 ] == '.' )
@@ -23,10 +23,13 @@
 /*************************************************************************************************/
 
 #include <iostream>
+#include <cctype>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <cerrno>
-#include <sstream>
+#include <charconv>
+#include <limits>
 #include <iomanip>
 
 #include "lineparser.h"
@@ -37,6 +40,9 @@
 #include "sourcefile.h"
 #include "random.h"
 #include "constants.h"
+#include "linecache.h"
+#include "singlepass.h"
+#include "statistics.h"
 
 
 using namespace std;
@@ -126,10 +132,7 @@ double LineParser::GetValue()
 	{
 		// get a number
 
-		istringstream str( m_line );
-		str.seekg( m_column );
-		str >> value;
-		m_column = static_cast< size_t >( str.tellg() );
+		value = GetDecimalLiteral();
 	}
 	else if ( m_column < m_line.length() && ( m_line[ m_column ] == '&' || m_line[ m_column ] == '$' ) )
 	{
@@ -146,14 +149,7 @@ double LineParser::GetValue()
 		{
 			// get a number
 
-			unsigned int hexValue;
-
-			istringstream str( m_line );
-			str.seekg( m_column );
-			str >> hex >> hexValue;
-			m_column = static_cast< size_t >( str.tellg() );
-
-			value = static_cast< double >( hexValue );
+			value = static_cast< double >( GetHexLiteral() );
 		}
 	}
 	else if ( m_column < m_line.length() && m_line[ m_column ] == '%' )
@@ -209,21 +205,8 @@ double LineParser::GetValue()
 
 		int oldColumn = m_column;
 		string symbolName = GetSymbolName();
-		bool bFoundSymbol = false;
-
-		for ( int forLevel = m_sourceCode->GetForLevel(); forLevel >= 0; forLevel-- )
-		{
-			string fullSymbolName = symbolName + m_sourceCode->GetSymbolNameSuffix( forLevel );
-
-			if ( SymbolTable::Instance().IsSymbolDefined( fullSymbolName ) )
-			{
-				value = SymbolTable::Instance().GetSymbol( fullSymbolName );
-				bFoundSymbol = true;
-				break;
-			}
-		}
 
-		if ( !bFoundSymbol )
+		if ( !LookUpSymbol( symbolName, value ) )
 		{
 			// symbol not known
 			throw AsmException_SyntaxError_SymbolNotDefined( m_line, oldColumn );
@@ -240,14 +223,623 @@ double LineParser::GetValue()
 
 
 
+/*************************************************************************************************/
+/**
+	IsRealLiteralTooBig()
+
+	Decides whether a real literal which from_chars() reports as out of range is too big for a
+	double, as opposed to too small, from the position of its first significant digit
+
+	@param		first			Start of the literal
+	@param		last			End of the literal
+
+	@return		bool			true if it overflows, false if it underflows
+*/
+/*************************************************************************************************/
+static bool IsRealLiteralTooBig( const char* first, const char* last )
+{
+	// Find the power of ten of the first significant digit of the mantissa...
+
+	long magnitude = 0;
+	bool bSignificant = false;
+	bool bPoint = false;
+
+	for ( ; first != last && ( isdigit( *first ) || *first == '.' ); ++first )
+	{
+		if ( *first == '.' )
+		{
+			bPoint = true;
+		}
+		else if ( *first != '0' || bSignificant )
+		{
+			bSignificant = true;
+			magnitude += bPoint ? 0 : 1;
+		}
+		else if ( bPoint )
+		{
+			magnitude--;
+		}
+	}
+
+	// ...and add the exponent, which can't matter beyond a few hundred
+
+	long exponent = 0;
+	bool bNegative = false;
+
+	if ( first != last )
+	{
+		++first;
+
+		if ( first != last && ( *first == '+' || *first == '-' ) )
+		{
+			bNegative = ( *first == '-' );
+			++first;
+		}
+	}
+
+	for ( ; first != last; ++first )
+	{
+		if ( exponent < 100000 )
+		{
+			exponent = exponent * 10 + ( *first - '0' );
+		}
+	}
+
+	return magnitude + ( bNegative ? -exponent : exponent ) > 0;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::GetDecimalLiteral()
+
+	Reads a decimal or real literal at the current column, advancing the string pointer.
+
+	The result, including the string pointer, is exactly what extracting a double from an
+	istringstream over the line would give in the "C" locale - so a literal which runs to the end
+	of the line leaves the string pointer at string::npos, and a malformed or too big one gives
+	0 or the largest double and leaves it at string::npos too.  Plain integers are converted
+	directly and reals with from_chars(), which neither allocates nor depends on the locale.
+
+	@return		double			The value of the literal
+*/
+/*************************************************************************************************/
+double LineParser::GetDecimalLiteral()
+{
+	const size_t length = m_line.length();
+	size_t column = m_column;
+
+	// Try a plain integer first; up to 15 digits are always exact in a double
+
+	double value = 0.0;
+	int digits = 0;
+
+	while ( column < length && isdigit( m_line[ column ] ) )
+	{
+		if ( digits > 0 || m_line[ column ] != '0' )
+		{
+			digits++;
+		}
+
+		value = value * 10.0 + ( m_line[ column ] - '0' );
+		column++;
+	}
+
+	bool bReal = ( column < length && ( m_line[ column ] == '.' || toupper( m_line[ column ] ) == 'E' ) );
+
+	if ( !bReal && digits <= 15 )
+	{
+		m_column = ( column < length ) ? column : string::npos;
+		return value;
+	}
+
+	// Otherwise find the end of the literal, in the same way as the stream does, and convert it
+
+	bool bMantissa = false;
+	bool bPoint = false;
+	bool bExponent = false;
+
+	column = m_column;
+
+	while ( column < length )
+	{
+		char c = m_line[ column ];
+
+		if ( isdigit( c ) )
+		{
+			bMantissa = bMantissa || !bExponent;
+		}
+		else if ( c == '.' && !bPoint && !bExponent )
+		{
+			bPoint = true;
+		}
+		else if ( toupper( c ) == 'E' && bMantissa && !bExponent )
+		{
+			bExponent = true;
+
+			if ( column + 1 < length && ( m_line[ column + 1 ] == '+' || m_line[ column + 1 ] == '-' ) )
+			{
+				column++;
+			}
+		}
+		else
+		{
+			break;
+		}
+
+		column++;
+	}
+
+	const char* first = m_line.data() + m_column;
+	const char* last = m_line.data() + column;
+	from_chars_result result = from_chars( first, last, value );
+
+	if ( result.ptr == last && result.ec == errc::result_out_of_range && !IsRealLiteralTooBig( first, last ) )
+	{
+		// the stream gives 0 for an underflow, and carries on as normal
+
+		value = 0.0;
+		result.ec = errc();
+	}
+
+	if ( result.ptr == last && result.ec == errc() )
+	{
+		m_column = ( column < length ) ? column : string::npos;
+		return value;
+	}
+
+	m_column = string::npos;
+	return ( result.ec == errc::result_out_of_range ) ? numeric_limits< double >::max() : 0.0;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::GetHexLiteral()
+
+	Reads a hex literal at the current column, advancing the string pointer.
+
+	As with GetDecimalLiteral(), the result is exactly what extracting a hex unsigned int from an
+	istringstream over the line would give.  That includes skipping a 0x prefix, and giving the
+	largest unsigned int and leaving the string pointer at string::npos if the value is too big,
+	or 0 if a 0x prefix has no digits after it.
+
+	@return		unsigned int	The value of the literal
+*/
+/*************************************************************************************************/
+unsigned int LineParser::GetHexLiteral()
+{
+	const size_t length = m_line.length();
+	size_t column = m_column;
+
+	if ( m_line[ column ] == '0' && column + 1 < length && toupper( m_line[ column + 1 ] ) == 'X' )
+	{
+		column += 2;
+	}
+
+	const size_t firstDigit = column;
+	unsigned int value = 0;
+	bool bTooBig = false;
+
+	while ( column < length && isxdigit( m_line[ column ] ) )
+	{
+		char c = m_line[ column++ ];
+		bTooBig = bTooBig || ( value > 0x0FFFFFFF );
+		value = value * 16 + ( isdigit( c ) ? c - '0' : toupper( c ) - 'A' + 10 );
+	}
+
+	if ( column == firstDigit )
+	{
+		m_column = string::npos;
+		return 0;
+	}
+
+	if ( bTooBig )
+	{
+		m_column = string::npos;
+		return numeric_limits< unsigned int >::max();
+	}
+
+	m_column = ( column < length ) ? column : string::npos;
+	return value;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::LookUpSymbol()
+
+	Finds the value of a symbol, searching from the innermost scope outwards
+
+	@param		symbolName		The symbol name, as written in the source
+	@param		value			Receives the value of the symbol
+
+	@return		bool			false if the symbol is not defined
+*/
+/*************************************************************************************************/
+bool LineParser::LookUpSymbol( const string& symbolName, double& value ) const
+{
+	int scope = m_sourceCode->GetScope();
+	int symbol = SymbolTable::Instance().ResolveSymbol( scope, symbolName );
+
+	if ( symbol == -1 )
+	{
+		return false;
+	}
+
+	if ( GlobalData::Instance().IsSinglePass() &&
+		 ( !m_sourceCode->HasOwnScope() || SymbolTable::Instance().FindSymbol( scope, symbolName ) != symbol ) )
+	{
+		SinglePass::Instance().AddOuterReference( symbolName );
+	}
+
+	value = SymbolTable::Instance().GetSymbolValue( symbol );
+	return true;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::LookUpSymbol()
+
+	As above, for a symbol pushed by a compiled expression.  The name was hashed when it was
+	compiled, and the handle found is kept in the instruction, so that evaluating it again from
+	the same scope doesn't search the symbol table at all unless a symbol has since been added or
+	removed.
+
+	@param		expression		The compiled expression
+	@param		instruction		Index of its PUSH_SYMBOL instruction
+	@param		value			Receives the value of the symbol
+
+	@return		bool			false if the symbol is not defined
+*/
+/*************************************************************************************************/
+bool LineParser::LookUpSymbol( const CompiledExpression& expression, size_t instruction, double& value ) const
+{
+	const CompiledExpression::Instruction& push = expression.m_program[ instruction ];
+	const string& symbolName = expression.m_symbols[ push.m_symbol ];
+	SymbolTable& symbolTable = SymbolTable::Instance();
+	int scope = m_sourceCode->GetScope();
+
+	if ( push.m_cachedScope != scope || push.m_cachedGeneration != symbolTable.GetGeneration() )
+	{
+		push.m_cachedScope = scope;
+		push.m_cachedHandle = symbolTable.ResolveSymbol( scope, push.m_nameHash, symbolName.data(), symbolName.length() );
+		push.m_cachedGeneration = symbolTable.GetGeneration();
+	}
+
+	int symbol = push.m_cachedHandle;
+
+	if ( symbol == -1 )
+	{
+		return false;
+	}
+
+	if ( GlobalData::Instance().IsSinglePass() &&
+		 ( !m_sourceCode->HasOwnScope() ||
+		   symbolTable.FindSymbol( scope, push.m_nameHash, symbolName.data(), symbolName.length() ) != symbol ) )
+	{
+		SinglePass::Instance().AddOuterReference( symbolName );
+	}
+
+	value = symbolTable.GetSymbolValue( symbol );
+	return true;
+}
+
+
+
 /*************************************************************************************************/
 /**
 	LineParser::EvaluateExpression()
 
 	Evaluates an expression, and returns its value, also advancing the string pointer
+
+	The first time an expression is successfully evaluated, it is compiled into a CompiledExpression
+	which is kept with the source line; after that, the compiled version is run instead.
+
+	In single pass mode, undefined symbols don't stop the expression being evaluated; it is
+	compiled as usual, and then SymbolNotDefined is thrown with the compiled expression left in
+	m_pDeferredExpression, so that the caller can record a fixup for it.
 */
 /*************************************************************************************************/
 double LineParser::EvaluateExpression( bool bAllowOneMismatchedCloseBracket )
+{
+	m_bUndefinedSymbol = false;
+	m_pDeferredExpression = NULL;
+
+	Statistics::Count( Statistics::EXPRESSIONS );
+
+	const CompiledExpression* compiled = m_sourceLine->FindExpression( m_column, bAllowOneMismatchedCloseBracket );
+	double value;
+
+	if ( compiled != NULL )
+	{
+		value = RunCompiledExpression( *compiled );
+	}
+	else
+	{
+		assert( m_pCompiledExpression == NULL );
+		m_pCompiledExpression = new CompiledExpression( m_column, bAllowOneMismatchedCloseBracket );
+
+		try
+		{
+			value = InterpretExpression( bAllowOneMismatchedCloseBracket );
+		}
+		catch ( ... )
+		{
+			delete m_pCompiledExpression;
+			m_pCompiledExpression = NULL;
+			throw;
+		}
+
+		m_pCompiledExpression->m_endColumn = m_column;
+		m_sourceLine->AddExpression( m_pCompiledExpression );
+		compiled = m_pCompiledExpression;
+		m_pCompiledExpression = NULL;
+	}
+
+	if ( m_bUndefinedSymbol )
+	{
+		m_pDeferredExpression = compiled;
+		throw AsmException_SyntaxError_SymbolNotDefined( m_line, m_undefinedSymbolColumn );
+	}
+
+	return value;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::RunCompiledExpression()
+
+	Evaluates a previously compiled expression, leaving the string pointer and stacks exactly as
+	InterpretExpression() would have done, including when an error is thrown
+*/
+/*************************************************************************************************/
+double LineParser::RunCompiledExpression( const CompiledExpression& expression )
+{
+	m_valueStackPtr = 0;
+	m_operatorStackPtr = 0;
+
+	const vector< CompiledExpression::Instruction >& program = expression.m_program;
+
+	for ( vector< CompiledExpression::Instruction >::const_iterator it = program.begin(); it != program.end(); ++it )
+	{
+		switch ( it->m_opcode )
+		{
+			case CompiledExpression::PUSH_CONSTANT:
+
+				m_valueStack[ m_valueStackPtr++ ] = it->m_value;
+				break;
+
+			case CompiledExpression::PUSH_PC:
+
+				m_valueStack[ m_valueStackPtr++ ] = static_cast< double >( ObjectCode::Instance().GetPC() );
+				break;
+
+			case CompiledExpression::PUSH_SYMBOL:
+			{
+				double value;
+
+				if ( !LookUpSymbol( expression, static_cast< size_t >( it - program.begin() ), value ) )
+				{
+					if ( GlobalData::Instance().IsSinglePass() )
+					{
+						// As in InterpretExpression(), carry on with a placeholder value
+
+						NoteUndefinedSymbol( it->m_column );
+						m_valueStack[ m_valueStackPtr++ ] = 0.0;
+						break;
+					}
+
+					// As in InterpretExpression(), on the first pass move beyond the expression
+					// before throwing
+
+					m_column = it->m_endColumn;
+
+					if ( GlobalData::Instance().IsFirstPass() )
+					{
+						SkipExpression( it->m_bracketCount, expression.m_bAllowOneMismatchedCloseBracket );
+					}
+
+					throw AsmException_SyntaxError_SymbolNotDefined( m_line, it->m_column );
+				}
+
+				m_valueStack[ m_valueStackPtr++ ] = value;
+				break;
+			}
+
+			case CompiledExpression::APPLY_OPERATOR:
+
+				m_column = it->m_column;
+				( this->*it->m_handler )();
+				break;
+		}
+	}
+
+	m_column = expression.m_endColumn;
+
+	return m_valueStack[ 0 ];
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::NoteUndefinedSymbol()
+
+	Records that an undefined symbol was met while evaluating an expression in single pass mode
+
+	@param		column			Column at which the symbol name starts
+*/
+/*************************************************************************************************/
+void LineParser::NoteUndefinedSymbol( size_t column )
+{
+	if ( !m_bUndefinedSymbol )
+	{
+		m_bUndefinedSymbol = true;
+		m_undefinedSymbolColumn = column;
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::FoldExpression()
+
+	Makes a copy of a compiled expression with the PC, and every symbol which can be resolved in
+	the given scope, replaced by its current value
+
+	@param		expression		The expression to fold
+	@param		scope			Scope to resolve symbols in
+
+	@return		CompiledExpression*		A new expression, owned by the caller, or NULL if the
+										expression calls RND(), which can't be evaluated again
+*/
+/*************************************************************************************************/
+CompiledExpression* LineParser::FoldExpression( const CompiledExpression& expression, int scope )
+{
+	CompiledExpression* folded = new CompiledExpression( expression.m_column, expression.m_bAllowOneMismatchedCloseBracket );
+	folded->m_endColumn = expression.m_endColumn;
+
+	const vector< CompiledExpression::Instruction >& program = expression.m_program;
+
+	for ( vector< CompiledExpression::Instruction >::const_iterator it = program.begin(); it != program.end(); ++it )
+	{
+		switch ( it->m_opcode )
+		{
+			case CompiledExpression::PUSH_CONSTANT:
+
+				folded->AddConstant( it->m_value );
+				break;
+
+			case CompiledExpression::PUSH_PC:
+
+				folded->AddConstant( static_cast< double >( ObjectCode::Instance().GetPC() ) );
+				break;
+
+			case CompiledExpression::PUSH_SYMBOL:
+			{
+				const string& symbolName = expression.m_symbols[ it->m_symbol ];
+				int symbol = SymbolTable::Instance().ResolveSymbol( scope, symbolName );
+
+				if ( symbol != -1 )
+				{
+					if ( SymbolTable::Instance().FindSymbol( scope, symbolName ) != symbol )
+					{
+						SinglePass::Instance().AddOuterReference( symbolName );
+					}
+
+					folded->AddConstant( SymbolTable::Instance().GetSymbolValue( symbol ) );
+				}
+				else
+				{
+					folded->AddSymbol( symbolName, it->m_column, it->m_endColumn, it->m_bracketCount );
+				}
+				break;
+			}
+
+			case CompiledExpression::APPLY_OPERATOR:
+
+				if ( it->m_handler == &LineParser::EvalRnd )
+				{
+					delete folded;
+					return NULL;
+				}
+
+				folded->AddOperator( it->m_handler, it->m_column );
+				break;
+		}
+	}
+
+	return folded;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::EvaluateFoldedExpression()
+
+	Evaluates an expression which FoldExpression() has reduced to constants
+
+	@param		sourceLine		The line containing the expression, for error reporting
+	@param		expression		The expression to evaluate
+*/
+/*************************************************************************************************/
+double LineParser::EvaluateFoldedExpression( SourceLine& sourceLine, const CompiledExpression& expression )
+{
+	assert( expression.m_symbols.empty() );
+
+	LineParser parser( NULL, sourceLine );
+	return parser.RunCompiledExpression( expression );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::AddFixup()
+
+	Records a fixup for the expression which EvaluateExpression() has just deferred, for an operand
+	about to be assembled at the PC
+
+	@param		type			What sort of operand it is
+*/
+/*************************************************************************************************/
+void LineParser::AddFixup( SinglePass::FIXUP_TYPE type )
+{
+	assert( m_pDeferredExpression != NULL );
+
+	// The fixup must see symbols defined later at this level, so the level needs its own scope
+
+	int scope = m_sourceCode->GetDefinitionScope();
+	CompiledExpression* folded = FoldExpression( *m_pDeferredExpression, scope );
+	m_pDeferredExpression = NULL;
+
+	if ( folded == NULL )
+	{
+		throw AsmException_SinglePassFailed();
+	}
+
+	SinglePass::Instance().AddFixup( type, ObjectCode::Instance().GetPC(), scope, m_sourceLine, folded );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::ApplyOperator()
+
+	Applies an operator to the value stack, recording it if the expression is being compiled
+*/
+/*************************************************************************************************/
+void LineParser::ApplyOperator( OperatorHandler handler )
+{
+	if ( m_pCompiledExpression != NULL )
+	{
+		m_pCompiledExpression->AddOperator( handler, m_column );
+	}
+
+	( this->*handler )();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::InterpretExpression()
+
+	Parses and evaluates an expression, advancing the string pointer
+*/
+/*************************************************************************************************/
+double LineParser::InterpretExpression( bool bAllowOneMismatchedCloseBracket )
 {
 	// Reset stacks
 
@@ -318,6 +910,7 @@ double LineParser::EvaluateExpression( bool bAllowOneMismatchedCloseBracket )
 				}
 
 				double value;
+				size_t valueColumn = m_column;
 
 				try
 				{
@@ -327,16 +920,48 @@ double LineParser::EvaluateExpression( bool bAllowOneMismatchedCloseBracket )
 				{
 					// If we encountered an unknown symbol whilst evaluating the expression...
 
-					if ( GlobalData::Instance().IsFirstPass() )
+					if ( GlobalData::Instance().IsSinglePass() )
 					{
-						// On first pass, we have to continue gracefully.
-						// This moves the string pointer to beyond the expression
+						// In single pass mode, carry on with a placeholder value so that the whole
+						// expression is compiled; EvaluateExpression() throws when it's done
+
+						NoteUndefinedSymbol( valueColumn );
+						value = 0.0;
+					}
+					else
+					{
+						if ( GlobalData::Instance().IsFirstPass() )
+						{
+							// On first pass, we have to continue gracefully.
+							// This moves the string pointer to beyond the expression
+
+							SkipExpression( bracketCount, bAllowOneMismatchedCloseBracket );
+						}
 
-						SkipExpression( bracketCount, bAllowOneMismatchedCloseBracket );
+						// Whatever happens, we throw the exception
+						throw;
 					}
+				}
+
+				if ( m_pCompiledExpression != NULL )
+				{
+					// Record where the value came from; only symbols and the PC can vary
 
-					// Whatever happens, we throw the exception
-					throw;
+					if ( m_line[ valueColumn ] == '*' )
+					{
+						m_pCompiledExpression->AddPC();
+					}
+					else if ( isalpha( m_line[ valueColumn ] ) || m_line[ valueColumn ] == '_' )
+					{
+						m_pCompiledExpression->AddSymbol( m_line.substr( valueColumn, m_column - valueColumn ),
+														  valueColumn,
+														  m_column,
+														  bracketCount );
+					}
+					else
+					{
+						m_pCompiledExpression->AddConstant( value );
+					}
 				}
 
 				m_valueStack[ m_valueStackPtr++ ] = value;
@@ -360,7 +985,7 @@ double LineParser::EvaluateExpression( bool bAllowOneMismatchedCloseBracket )
 						OperatorHandler opHandler = m_operatorStack[ m_operatorStackPtr ].handler;
 						assert( opHandler != NULL );	// this should really not be possible!
 
-						( this->*opHandler )();
+						ApplyOperator( opHandler );
 					}
 				}
 				else
@@ -430,7 +1055,7 @@ double LineParser::EvaluateExpression( bool bAllowOneMismatchedCloseBracket )
 					OperatorHandler opHandler = m_operatorStack[ m_operatorStackPtr ].handler;
 					assert( opHandler != NULL );	// this means the operator has been given a precedence of < 0
 
-					( this->*opHandler )();
+					ApplyOperator( opHandler );
 				}
 
 				if ( m_operatorStackPtr == MAX_OPERATORS )
@@ -457,7 +1082,7 @@ double LineParser::EvaluateExpression( bool bAllowOneMismatchedCloseBracket )
 					OperatorHandler opHandler = m_operatorStack[ m_operatorStackPtr ].handler;
 					if ( opHandler != NULL )
 					{
-						( this->*opHandler )();
+						ApplyOperator( opHandler );
 					}
 					else
 					{
@@ -502,7 +1127,7 @@ double LineParser::EvaluateExpression( bool bAllowOneMismatchedCloseBracket )
 		}
 		else
 		{
-			( this->*opHandler )();
+			ApplyOperator( opHandler );
 		}
 	}
 
@@ -1302,6 +1927,8 @@ void LineParser::EvalRnd()
 	double val = m_valueStack[ m_valueStackPtr - 1 ];
 	double result = 0.0;
 
+	GlobalData::Instance().SetNotRepeatable();
+
 	if ( val < 1.0f )
 	{
 		throw AsmException_SyntaxError_IllegalOperation( m_line, m_column - 1 );
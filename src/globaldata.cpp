@@ -23,7 +23,6 @@
 #include "globaldata.h"
 #include <iostream>
 
-GlobalData* GlobalData::m_gInstance = NULL;
 
 
 
@@ -36,9 +35,9 @@ GlobalData* GlobalData::m_gInstance = NULL;
 /*************************************************************************************************/
 void GlobalData::Create()
 {
-	assert( m_gInstance == NULL );
+	assert( AssemblyContext::Current().m_pGlobalData == NULL );
 
-	m_gInstance = new GlobalData;
+	AssemblyContext::Current().m_pGlobalData = new GlobalData;
 }
 
 
@@ -52,10 +51,10 @@ void GlobalData::Create()
 /*************************************************************************************************/
 void GlobalData::Destroy()
 {
-	assert( m_gInstance != NULL );
+	assert( AssemblyContext::Current().m_pGlobalData != NULL );
 
-	delete m_gInstance;
-	m_gInstance = NULL;
+	delete AssemblyContext::Current().m_pGlobalData;
+	AssemblyContext::Current().m_pGlobalData = NULL;
 }
 
 
@@ -68,17 +67,22 @@ void GlobalData::Destroy()
 */
 /*************************************************************************************************/
 GlobalData::GlobalData()
-	:	m_pBootFile( NULL ),
+	:	m_bSinglePass( false ),
+		m_pBootFile( NULL ),
 		m_bVerbose( false ),
 		m_bUseDiscImage( false ),
 		m_pDiscImage( NULL ),
+		m_pVirtualFiles( NULL ),
+		m_pPrintStream( &std::cout ),
+		m_pSharedFiles( NULL ),
 		m_bSaved( false ),
 		m_pOutputFile( NULL ),
 		m_numAnonSaves( 0 ),
 		m_discOption( 0 ),
 		m_assemblyTime( time( NULL ) ),
 		m_bRequireDistinctOpcodes( false ),
-		m_bUseVisualCppErrorFormat( false )
+		m_bUseVisualCppErrorFormat( false ),
+		m_bRepeatable( true )
 {
 	// We populate m_assemblyTime with a time on startup so that all uses of TIME$ during 
 	// assembly refer to the exact same time, however long we spend assembling.
@@ -101,3 +105,93 @@ GlobalData::GlobalData()
 GlobalData::~GlobalData()
 {
 }
+
+
+
+/*************************************************************************************************/
+/**
+	GlobalData::SetOptions()
+
+	Copies the settings given on the command line from another GlobalData, so that another
+	assembly can be run in the same way
+
+	@param		options			GlobalData to copy from
+*/
+/*************************************************************************************************/
+void GlobalData::SetOptions( const GlobalData& options )
+{
+	m_pBootFile = options.m_pBootFile;
+	m_bVerbose = options.m_bVerbose;
+	m_bUseDiscImage = options.m_bUseDiscImage;
+	m_pOutputFile = options.m_pOutputFile;
+	m_discOption = options.m_discOption;
+	m_discTitle = options.m_discTitle;
+	m_assemblyTime = options.m_assemblyTime;
+	m_bRequireDistinctOpcodes = options.m_bRequireDistinctOpcodes;
+	m_bUseVisualCppErrorFormat = options.m_bUseVisualCppErrorFormat;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	GlobalData::GetOutputPath()
+
+	Gets where a file being saved should be written, by placing relative filenames in the output
+	directory, if there is one
+
+	@param		filename		Filename, as given in the source or on the command line
+
+	@return		string			Path to write to
+*/
+/*************************************************************************************************/
+std::string GlobalData::GetOutputPath( const std::string& filename ) const
+{
+	bool bAbsolute = ( !filename.empty() && ( filename[ 0 ] == '/' || filename[ 0 ] == '\\' ) ) ||
+					 ( filename.length() > 1 && filename[ 1 ] == ':' );
+
+	if ( m_outputDirectory.empty() || bAbsolute )
+	{
+		return filename;
+	}
+
+	return m_outputDirectory + "/" + filename;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	GlobalData::AddInputFile()
+
+	Records a file which the assembly has read, if it hasn't already been recorded
+
+	@param		filename		Filename, as given in the source or on the command line
+*/
+/*************************************************************************************************/
+void GlobalData::AddInputFile( const std::string& filename )
+{
+	if ( m_files.insert( filename ).second )
+	{
+		m_inputFiles.push_back( filename );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	GlobalData::AddOutputFile()
+
+	Records a file which the assembly has written, if it hasn't already been recorded
+
+	@param		filename		Filename, as given in the source or on the command line
+*/
+/*************************************************************************************************/
+void GlobalData::AddOutputFile( const std::string& filename )
+{
+	if ( m_files.insert( filename ).second )
+	{
+		m_outputFiles.push_back( filename );
+	}
+}
@@ -26,10 +26,16 @@
 #include <cassert>
 #include <cstdlib>
 #include <ctime>
+#include <iosfwd>
+#include <set>
 #include <string>
+#include <vector>
+#include "assemblycontext.h"
 
 
 class DiscImage;
+class VirtualFiles;
+class SharedFiles;
 
 class GlobalData
 {
@@ -37,15 +43,23 @@ public:
 
 	static void Create();
 	static void Destroy();
-	static inline GlobalData& Instance() { assert( m_gInstance != NULL ); return *m_gInstance; }
+	static inline GlobalData& Instance() { assert( AssemblyContext::Current().m_pGlobalData != NULL ); return *AssemblyContext::Current().m_pGlobalData; }
 
 	inline void SetPass( int i )				{ m_pass = i; }
 	inline void SetBootFile( const char* p )	{ m_pBootFile = p; }
 	inline void SetVerbose( bool b )			{ m_bVerbose = b; }
 	inline void SetUseDiscImage( bool b )		{ m_bUseDiscImage = b; }
 	inline void SetDiscImage( DiscImage* d )	{ m_pDiscImage = d; }
+	inline void SetVirtualFiles( VirtualFiles* v )	{ m_pVirtualFiles = v; }
+	inline void SetPrintStream( std::ostream* s )	{ m_pPrintStream = s; }
+	inline void SetSharedFiles( SharedFiles* s )	{ m_pSharedFiles = s; }
+	inline void SetOutputDirectory( const std::string& d )
+												{ m_outputDirectory = d; }
+	void SetOptions( const GlobalData& options );
 	inline void ResetForId()					{ m_forId = 0; }
 	inline void SetSaved()						{ m_bSaved = true; }
+	inline void ResetSaved()					{ m_bSaved = false; m_numAnonSaves = 0; }
+	inline void SetSinglePass( bool b )			{ m_bSinglePass = b; }
 	inline void SetOutputFile( const char* p )	{ m_pOutputFile = p; }
 	inline void IncNumAnonSaves()				{ m_numAnonSaves++; }
 	inline void SetDiscOption( int opt )		{ m_discOption = opt; }
@@ -55,14 +69,22 @@ public:
 												{ m_bRequireDistinctOpcodes = b; }
 	inline void SetUseVisualCppErrorFormat( bool b )
 												{ m_bUseVisualCppErrorFormat = b; }
+	inline void SetNotRepeatable()				{ m_bRepeatable = false; }
 
 	inline int GetPass() const					{ return m_pass; }
 	inline bool IsFirstPass() const				{ return ( m_pass == 0 ); }
 	inline bool IsSecondPass() const			{ return ( m_pass == 1 ); }
+	inline bool IsSinglePass() const			{ return m_bSinglePass; }
+	inline bool IsDefiningPass() const			{ return ( m_pass == 0 || m_bSinglePass ); }
 	inline bool ShouldOutputAsm() const			{ return ( m_pass == 1 && m_bVerbose ); }
+	inline bool IsVerbose() const				{ return m_bVerbose; }
 	inline const char* GetBootFile() const		{ return m_pBootFile; }
 	inline bool UsesDiscImage() const			{ return m_bUseDiscImage; }
 	inline DiscImage* GetDiscImage() const		{ return m_pDiscImage; }
+	inline VirtualFiles* GetVirtualFiles() const	{ return m_pVirtualFiles; }
+	inline std::ostream& GetPrintStream() const	{ return *m_pPrintStream; }
+	inline SharedFiles* GetSharedFiles() const	{ return m_pSharedFiles; }
+	std::string GetOutputPath( const std::string& filename ) const;
 	inline int GetNextForId()					{ return m_forId++; }
 	inline bool IsSaved() const					{ return m_bSaved; }
 	inline const char* GetOutputFile() const	{ return m_pOutputFile; }
@@ -73,19 +95,32 @@ public:
 	inline time_t GetAssemblyTime() const		{ return m_assemblyTime; }
 	inline bool RequireDistinctOpcodes() const  { return m_bRequireDistinctOpcodes; }
 	inline bool UseVisualCppErrorFormat() const { return m_bUseVisualCppErrorFormat; }
+	inline bool IsRepeatable() const			{ return m_bRepeatable; }
+
+	// Files read and written by the assembly, for the dependency file
+
+	void AddInputFile( const std::string& filename );
+	void AddOutputFile( const std::string& filename );
+	inline const std::vector< std::string >& GetInputFiles() const
+												{ return m_inputFiles; }
+	inline const std::vector< std::string >& GetOutputFiles() const
+												{ return m_outputFiles; }
 
 private:
 
 	GlobalData();
 	~GlobalData();
 
-	static GlobalData*			m_gInstance;
-
 	int							m_pass;
+	bool						m_bSinglePass;
 	const char*					m_pBootFile;
 	bool						m_bVerbose;
 	bool						m_bUseDiscImage;
 	DiscImage*					m_pDiscImage;
+	VirtualFiles*				m_pVirtualFiles;	// if non-NULL, files are read from and saved to memory
+	std::ostream*				m_pPrintStream;		// where PRINT output goes
+	SharedFiles*				m_pSharedFiles;		// if non-NULL, source is read through this
+	std::string					m_outputDirectory;	// if not empty, where files are saved
 	int							m_forId;
 	bool						m_bSaved;
 	const char*					m_pOutputFile;
@@ -95,6 +130,10 @@ private:
 	time_t						m_assemblyTime;
 	bool						m_bRequireDistinctOpcodes;
 	bool						m_bUseVisualCppErrorFormat;
+	bool						m_bRepeatable;		// false if TIME$ or RND() was used
+	std::vector< std::string >	m_inputFiles;
+	std::vector< std::string >	m_outputFiles;
+	std::set< std::string >		m_files;			// everything in either list, to filter repeats
 };
 
 
@@ -0,0 +1,316 @@
+/*************************************************************************************************/
+/**
+	instrumentation.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <algorithm>
+
+#include "instrumentation.h"
+#include "sourcecode.h"
+
+
+using namespace std;
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::Add()
+
+	Adds an instrument to the current AssemblyContext
+
+	@param		pInstrument		The instrument, which must be removed again before it is destroyed
+*/
+/*************************************************************************************************/
+void Instrumentation::Add( Instrument* pInstrument )
+{
+	AssemblyContext::Current().m_instruments.push_back( pInstrument );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::Remove()
+
+	Removes an instrument from the current AssemblyContext
+
+	@param		pInstrument		The instrument
+*/
+/*************************************************************************************************/
+void Instrumentation::Remove( Instrument* pInstrument )
+{
+	vector< Instrument* >& instruments = AssemblyContext::Current().m_instruments;
+
+	instruments.erase( remove( instruments.begin(), instruments.end(), pInstrument ), instruments.end() );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::BeginPass()
+
+	@param		name			Name of the pass
+*/
+/*************************************************************************************************/
+void Instrumentation::BeginPass( const string& name )
+{
+	vector< Instrument* >& instruments = AssemblyContext::Current().m_instruments;
+
+	for ( vector< Instrument* >::iterator it = instruments.begin(); it != instruments.end(); ++it )
+	{
+		( *it )->BeginPass( name );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::EndPass()
+
+	Finishes the current pass, if there is one.  This is also called when an error stops a pass
+	part way through.
+*/
+/*************************************************************************************************/
+void Instrumentation::EndPass()
+{
+	vector< Instrument* >& instruments = AssemblyContext::Current().m_instruments;
+
+	for ( vector< Instrument* >::iterator it = instruments.begin(); it != instruments.end(); ++it )
+	{
+		( *it )->EndPass();
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::BeginLine()
+
+	@param		filename		File containing the line
+	@param		lineNumber		Line number
+*/
+/*************************************************************************************************/
+void Instrumentation::BeginLine( const string& filename, int lineNumber )
+{
+	vector< Instrument* >& instruments = AssemblyContext::Current().m_instruments;
+
+	for ( vector< Instrument* >::iterator it = instruments.begin(); it != instruments.end(); ++it )
+	{
+		( *it )->BeginLine( filename, lineNumber );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::BeginFor()
+
+	@param		filename		File containing the FOR
+	@param		lineNumber		Line number of the FOR
+*/
+/*************************************************************************************************/
+void Instrumentation::BeginFor( const string& filename, int lineNumber )
+{
+	vector< Instrument* >& instruments = AssemblyContext::Current().m_instruments;
+
+	for ( vector< Instrument* >::iterator it = instruments.begin(); it != instruments.end(); ++it )
+	{
+		( *it )->BeginFor( filename, lineNumber );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::EndFor()
+
+	Finishes the innermost FOR loop
+
+	@param		numIterations	Number of times its body was assembled
+*/
+/*************************************************************************************************/
+void Instrumentation::EndFor( int numIterations )
+{
+	vector< Instrument* >& instruments = AssemblyContext::Current().m_instruments;
+
+	for ( vector< Instrument* >::iterator it = instruments.begin(); it != instruments.end(); ++it )
+	{
+		( *it )->EndFor( numIterations );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::EnterSource()
+
+	@param		name			Filename, or macro name
+	@param		bIsMacro		Whether it is a macro instance
+*/
+/*************************************************************************************************/
+void Instrumentation::EnterSource( const string& name, bool bIsMacro )
+{
+	vector< Instrument* >& instruments = AssemblyContext::Current().m_instruments;
+
+	for ( vector< Instrument* >::iterator it = instruments.begin(); it != instruments.end(); ++it )
+	{
+		( *it )->EnterSource( name, bIsMacro );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::ExitSource()
+
+	Exits the innermost source file or macro instance, telling the instruments in the reverse order
+	to which they were told about entering it
+
+	@param		name			Filename, or macro name
+	@param		bIsMacro		Whether it is a macro instance
+	@param		numLines		Number of lines processed, counting each FOR iteration
+*/
+/*************************************************************************************************/
+void Instrumentation::ExitSource( const string& name, bool bIsMacro, unsigned long numLines )
+{
+	vector< Instrument* >& instruments = AssemblyContext::Current().m_instruments;
+
+	for ( vector< Instrument* >::reverse_iterator it = instruments.rbegin(); it != instruments.rend(); ++it )
+	{
+		( *it )->ExitSource( name, bIsMacro, numLines );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::BeginWrite()
+
+	@param		pKind			"save", or "disc" for a file added to the disc image
+	@param		name			Name of the file
+*/
+/*************************************************************************************************/
+void Instrumentation::BeginWrite( const char* pKind, const string& name )
+{
+	vector< Instrument* >& instruments = AssemblyContext::Current().m_instruments;
+
+	for ( vector< Instrument* >::iterator it = instruments.begin(); it != instruments.end(); ++it )
+	{
+		( *it )->BeginWrite( pKind, name );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Instrumentation::EndWrite()
+*/
+/*************************************************************************************************/
+void Instrumentation::EndWrite()
+{
+	vector< Instrument* >& instruments = AssemblyContext::Current().m_instruments;
+
+	for ( vector< Instrument* >::reverse_iterator it = instruments.rbegin(); it != instruments.rend(); ++it )
+	{
+		( *it )->EndWrite();
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	InstrumentedSource::InstrumentedSource()
+
+	@param		name			Filename, or macro name
+	@param		bIsMacro		Whether it is a macro instance
+	@param		source			The SourceFile or MacroInstance, to count the lines it processes
+*/
+/*************************************************************************************************/
+InstrumentedSource::InstrumentedSource( const string& name, bool bIsMacro, const SourceCode& source )
+	:	m_bActive( Instrumentation::IsActive() ),
+		m_name( name ),
+		m_bIsMacro( bIsMacro ),
+		m_source( source )
+{
+	if ( m_bActive )
+	{
+		Instrumentation::EnterSource( m_name, m_bIsMacro );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	InstrumentedSource::~InstrumentedSource()
+*/
+/*************************************************************************************************/
+InstrumentedSource::~InstrumentedSource()
+{
+	if ( m_bActive )
+	{
+		Instrumentation::ExitSource( m_name, m_bIsMacro, m_source.GetNumLinesProcessed() );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	InstrumentedWrite::InstrumentedWrite()
+
+	@param		pKind			"save", or "disc" for a file added to the disc image
+	@param		name			Name of the file
+*/
+/*************************************************************************************************/
+InstrumentedWrite::InstrumentedWrite( const char* pKind, const string& name )
+	:	m_bActive( Instrumentation::IsActive() )
+{
+	if ( m_bActive )
+	{
+		Instrumentation::BeginWrite( pKind, name );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	InstrumentedWrite::~InstrumentedWrite()
+*/
+/*************************************************************************************************/
+InstrumentedWrite::~InstrumentedWrite()
+{
+	if ( m_bActive )
+	{
+		Instrumentation::EndWrite();
+	}
+}
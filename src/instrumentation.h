@@ -0,0 +1,130 @@
+/*************************************************************************************************/
+/**
+	instrumentation.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef INSTRUMENTATION_H_
+#define INSTRUMENTATION_H_
+
+#include <string>
+#include <vector>
+
+#include "assemblycontext.h"
+
+class SourceCode;
+
+
+// Something which watches the assembler at work, such as the statistics, profiler or tracer.  It
+// is told when each pass, source file, macro instance, FOR loop and line is started and finished,
+// and overrides whichever of these it needs.
+
+class Instrument
+{
+public:
+
+	virtual ~Instrument() {}
+
+	virtual void BeginPass( const std::string& ) {}
+	virtual void EndPass() {}
+
+	// A source file or macro instance; exits also happen when an error unwinds past it, leaving
+	// any FOR loops inside it unfinished
+	virtual void EnterSource( const std::string&, bool ) {}
+	virtual void ExitSource( const std::string&, bool, unsigned long ) {}
+
+	virtual void BeginLine( const std::string&, int ) {}
+
+	virtual void BeginFor( const std::string&, int ) {}
+	virtual void EndFor( int ) {}
+
+	// A SAVE, or a file being added to the disc image
+	virtual void BeginWrite( const char*, const std::string& ) {}
+	virtual void EndWrite() {}
+};
+
+
+
+// Passes each event on to all of the instruments added to the current AssemblyContext
+
+class Instrumentation
+{
+public:
+
+	static void Add( Instrument* pInstrument );
+	static void Remove( Instrument* pInstrument );
+
+	static inline bool IsActive() { return !AssemblyContext::Current().m_instruments.empty(); }
+
+	static void BeginPass( const std::string& name );
+	static void EndPass();
+	static void BeginLine( const std::string& filename, int lineNumber );
+	static void BeginFor( const std::string& filename, int lineNumber );
+	static void EndFor( int numIterations );
+
+
+private:
+
+	friend class InstrumentedSource;
+	friend class InstrumentedWrite;
+
+	static void EnterSource( const std::string& name, bool bIsMacro );
+	static void ExitSource( const std::string& name, bool bIsMacro, unsigned long numLines );
+	static void BeginWrite( const char* pKind, const std::string& name );
+	static void EndWrite();
+};
+
+
+
+// Enters a source file or macro instance for as long as it exists
+
+class InstrumentedSource
+{
+public:
+
+	InstrumentedSource( const std::string& name, bool bIsMacro, const SourceCode& source );
+	~InstrumentedSource();
+
+private:
+
+	bool					m_bActive;
+	const std::string&		m_name;
+	bool					m_bIsMacro;
+	const SourceCode&		m_source;
+};
+
+
+
+// Reports a write for as long as it exists
+
+class InstrumentedWrite
+{
+public:
+
+	InstrumentedWrite( const char* pKind, const std::string& name );
+	~InstrumentedWrite();
+
+private:
+
+	bool					m_bActive;
+};
+
+
+
+#endif // INSTRUMENTATION_H_
@@ -0,0 +1,119 @@
+/*************************************************************************************************/
+/**
+	libbeebasm.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <sstream>
+
+#include "libbeebasm.h"
+#include "assemblycontext.h"
+#include "asmexception.h"
+#include "globaldata.h"
+#include "objectcode.h"
+#include "random.h"
+#include "sourcefile.h"
+#include "symboltable.h"
+
+
+using namespace std;
+
+
+
+/*************************************************************************************************/
+/**
+	AssembleInMemory()
+
+	Assembles a source file held in memory
+
+	@param		filename		Name of the main source file, which must be one of the files
+	@param		files			Contents of every file the source may read, keyed by the names
+								used in the source
+	@param		symbols			Symbols to define before assembling, each as for -D
+	@param		randomSeed		Seed for RND()
+	@param		result			Returns the result of assembling
+
+	@return		bool			true if the source assembled without error
+*/
+/*************************************************************************************************/
+bool AssembleInMemory( const string& filename,
+					   const map< string, string >& files,
+					   const vector< string >& symbols,
+					   unsigned long randomSeed,
+					   AssemblyResult& result )
+{
+	AssemblyContext context;
+	VirtualFiles virtualFiles( files );
+	ostringstream output;
+
+	GlobalData::Instance().SetVirtualFiles( &virtualFiles );
+	GlobalData::Instance().SetPrintStream( &output );
+
+	result.m_bSucceeded = true;
+	result.m_error = AssemblyError();
+	result.m_error.m_column = 0;
+
+	try
+	{
+		for ( vector< string >::const_iterator it = symbols.begin(); it != symbols.end(); ++it )
+		{
+			if ( !SymbolTable::Instance().AddCommandLineSymbol( *it ) )
+			{
+				result.m_bSucceeded = false;
+				result.m_error.m_message = "Invalid symbol definition: " + *it;
+				break;
+			}
+		}
+
+		for ( int pass = 0; result.m_bSucceeded && pass < 2; pass++ )
+		{
+			GlobalData::Instance().SetPass( pass );
+			ObjectCode::Instance().InitialisePass();
+			GlobalData::Instance().ResetForId();
+			beebasm_srand( randomSeed );
+			SourceFile input( filename );
+			input.Process();
+		}
+	}
+	catch ( AsmException_SyntaxError& e )
+	{
+		result.m_bSucceeded = false;
+		result.m_error.m_message = e.GetMessage();
+		result.m_error.m_line = e.GetLine();
+		result.m_error.m_column = e.GetColumn();
+		result.m_error.m_filenames = e.GetFilenames();
+		result.m_error.m_lineNumbers = e.GetLineNumbers();
+	}
+	catch ( AsmException_FileError& e )
+	{
+		result.m_bSucceeded = false;
+		result.m_error.m_message = e.Message();
+		result.m_error.m_filenames.assign( 1, e.GetFilename() );
+		result.m_error.m_lineNumbers.assign( 1, 0 );
+	}
+
+	const unsigned char* pMemory = ObjectCode::Instance().GetAddr( 0 );
+	result.m_memory.assign( pMemory, pMemory + 0x10000 );
+	result.m_saveBlocks = virtualFiles.GetSaveBlocks();
+	result.m_symbols.clear();
+	SymbolTable::Instance().GetGlobalSymbols( result.m_symbols );
+	result.m_output = output.str();
+
+	return result.m_bSucceeded;
+}
@@ -0,0 +1,66 @@
+/*************************************************************************************************/
+/**
+	libbeebasm.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef LIBBEEBASM_H_
+#define LIBBEEBASM_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "virtualfiles.h"
+
+
+// Interface for assembling in memory, for programs which link with libbeebasm.  Nothing is read
+// from or written to the filesystem, nothing is printed, and each call assembles in its own
+// AssemblyContext, so separate threads can assemble at the same time.  There is no disc image,
+// so PUTFILE and PUTTEXT only check that their file exists, and PUTBASIC does nothing.
+
+struct AssemblyError
+{
+	std::string						m_message;
+	std::string						m_line;			// source line, empty for file errors
+	int								m_column;
+	std::vector< std::string >		m_filenames;	// the first is where the error is, any others
+	std::vector< int >				m_lineNumbers;	// are where it was included or called from
+};
+
+
+struct AssemblyResult
+{
+	bool									m_bSucceeded;
+	AssemblyError							m_error;		// if not succeeded
+	std::vector< unsigned char >			m_memory;		// all 64K of the assembled memory
+	std::vector< VirtualFiles::SaveBlock >	m_saveBlocks;
+	std::map< std::string, double >			m_symbols;		// global symbols
+	std::string								m_output;		// text from PRINT
+};
+
+
+bool AssembleInMemory( const std::string& filename,
+					   const std::map< std::string, std::string >& files,
+					   const std::vector< std::string >& symbols,
+					   unsigned long randomSeed,
+					   AssemblyResult& result );
+
+
+
+#endif // LIBBEEBASM_H_
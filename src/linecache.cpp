@@ -0,0 +1,527 @@
+/*************************************************************************************************/
+/**
+	linecache.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "linecache.h"
+#include "asmexception.h"
+#include "globaldata.h"
+#include "virtualfiles.h"
+#include "sharedfiles.h"
+#include "symboltable.h"
+
+
+using namespace std;
+
+
+
+
+/*************************************************************************************************/
+/**
+	CompiledExpression::CompiledExpression()
+
+	Constructor for CompiledExpression
+
+	@param		column							Column at which the expression starts
+	@param		bAllowOneMismatchedCloseBracket	Whether it was parsed allowing a trailing ')'
+*/
+/*************************************************************************************************/
+CompiledExpression::CompiledExpression( size_t column, bool bAllowOneMismatchedCloseBracket )
+	:	m_column( column ),
+		m_bAllowOneMismatchedCloseBracket( bAllowOneMismatchedCloseBracket ),
+		m_endColumn( column )
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	CompiledExpression::AddConstant()
+
+	Appends an instruction to push a literal value
+*/
+/*************************************************************************************************/
+void CompiledExpression::AddConstant( double value )
+{
+	Instruction instruction = Instruction();
+	instruction.m_opcode = PUSH_CONSTANT;
+	instruction.m_value = value;
+	m_program.push_back( instruction );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	CompiledExpression::AddPC()
+
+	Appends an instruction to push the current PC
+*/
+/*************************************************************************************************/
+void CompiledExpression::AddPC()
+{
+	Instruction instruction = Instruction();
+	instruction.m_opcode = PUSH_PC;
+	m_program.push_back( instruction );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	CompiledExpression::AddSymbol()
+
+	Appends an instruction to push the value of a symbol
+
+	@param		symbolName		The symbol name, as written in the source
+	@param		column			Column at which the symbol name starts
+	@param		endColumn		Column following the symbol name
+	@param		bracketCount	Number of brackets open at this point in the expression
+*/
+/*************************************************************************************************/
+void CompiledExpression::AddSymbol( const string& symbolName, size_t column, size_t endColumn, int bracketCount )
+{
+	Instruction instruction = Instruction();
+	instruction.m_opcode = PUSH_SYMBOL;
+	instruction.m_symbol = static_cast< int >( m_symbols.size() );
+	instruction.m_nameHash = SymbolTable::Hash( symbolName.data(), symbolName.length() );
+	instruction.m_cachedScope = -1;
+	instruction.m_bracketCount = bracketCount;
+	instruction.m_column = column;
+	instruction.m_endColumn = endColumn;
+	m_program.push_back( instruction );
+
+	m_symbols.push_back( symbolName );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	CompiledExpression::AddOperator()
+
+	Appends an instruction to apply an operator to the value stack
+
+	@param		handler			The operator's handler
+	@param		column			Column at which the operator was applied, for error reporting
+*/
+/*************************************************************************************************/
+void CompiledExpression::AddOperator( void ( LineParser::*handler )(), size_t column )
+{
+	Instruction instruction = Instruction();
+	instruction.m_opcode = APPLY_OPERATOR;
+	instruction.m_column = column;
+	instruction.m_handler = handler;
+	m_program.push_back( instruction );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceLine::SourceLine()
+
+	Constructor for SourceLine
+
+	@param		text				The line, with tabs already expanded
+	@param		nextFilePointer		File pointer of the line which follows it
+*/
+/*************************************************************************************************/
+SourceLine::SourceLine( const string& text, int nextFilePointer )
+	:	m_text( text ),
+		m_nextFilePointer( nextFilePointer )
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceLine::~SourceLine()
+
+	Destructor for SourceLine
+*/
+/*************************************************************************************************/
+SourceLine::~SourceLine()
+{
+	for ( vector< CompiledExpression* >::iterator it = m_expressions.begin(); it != m_expressions.end(); ++it )
+	{
+		delete *it;
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceLine::FindStatement()
+
+	Returns the lexed statement which starts at the given column, or NULL if that statement has
+	not been seen yet
+*/
+/*************************************************************************************************/
+const SourceLine::Statement* SourceLine::FindStatement( size_t column ) const
+{
+	for ( vector< Statement >::const_iterator it = m_statements.begin(); it != m_statements.end(); ++it )
+	{
+		if ( it->m_column == column )
+		{
+			return &*it;
+		}
+	}
+
+	return NULL;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceLine::AddStatement()
+
+	Remembers a lexed statement so that subsequent passes over the line can replay it
+*/
+/*************************************************************************************************/
+const SourceLine::Statement* SourceLine::AddStatement( const Statement& statement )
+{
+	m_statements.push_back( statement );
+	return &m_statements.back();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceLine::FindExpression()
+
+	Returns the compiled expression which starts at the given column, or NULL if that expression
+	has not been successfully evaluated yet
+*/
+/*************************************************************************************************/
+const CompiledExpression* SourceLine::FindExpression( size_t column, bool bAllowOneMismatchedCloseBracket ) const
+{
+	for ( vector< CompiledExpression* >::const_iterator it = m_expressions.begin(); it != m_expressions.end(); ++it )
+	{
+		if ( ( *it )->m_column == column &&
+			 ( *it )->m_bAllowOneMismatchedCloseBracket == bAllowOneMismatchedCloseBracket )
+		{
+			return *it;
+		}
+	}
+
+	return NULL;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceLine::AddExpression()
+
+	Remembers a compiled expression; the SourceLine takes ownership of it
+*/
+/*************************************************************************************************/
+void SourceLine::AddExpression( CompiledExpression* expression )
+{
+	m_expressions.push_back( expression );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineCache::Create()
+
+	Creates the LineCache singleton
+*/
+/*************************************************************************************************/
+void LineCache::Create()
+{
+	assert( AssemblyContext::Current().m_pLineCache == NULL );
+
+	AssemblyContext::Current().m_pLineCache = new LineCache;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineCache::Destroy()
+
+	Destroys the LineCache singleton
+*/
+/*************************************************************************************************/
+void LineCache::Destroy()
+{
+	assert( AssemblyContext::Current().m_pLineCache != NULL );
+
+	delete AssemblyContext::Current().m_pLineCache;
+	AssemblyContext::Current().m_pLineCache = NULL;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineCache::LineCache()
+
+	LineCache constructor
+*/
+/*************************************************************************************************/
+LineCache::LineCache()
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineCache::~LineCache()
+
+	LineCache destructor
+*/
+/*************************************************************************************************/
+LineCache::~LineCache()
+{
+	for ( vector< LineMap >::iterator source = m_sources.begin(); source != m_sources.end(); ++source )
+	{
+		for ( LineMap::iterator it = source->begin(); it != source->end(); ++it )
+		{
+			delete it->second;
+		}
+	}
+
+	for ( vector< SourceBuffer* >::iterator it = m_buffers.begin(); it != m_buffers.end(); ++it )
+	{
+		delete *it;
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineCache::GetSourceId()
+
+	Returns the id under which lines of the named source file are cached, allocating one the
+	first time the file is seen.  Files are identified by their canonical path, so a file which is
+	included from several places, under different relative names, is only read once.
+
+	@param		filename		Filename of the source file
+*/
+/*************************************************************************************************/
+int LineCache::GetSourceId( const string& filename )
+{
+	string path = GetCanonicalPath( filename );
+	map< string, int >::iterator it = m_fileIds.find( path );
+
+	if ( it != m_fileIds.end() )
+	{
+		if ( GlobalData::Instance().IsVerbose() )
+		{
+			cerr << "Source cache hit: " << filename << endl;
+		}
+
+		return it->second;
+	}
+
+	if ( GlobalData::Instance().IsVerbose() )
+	{
+		cerr << "Source cache miss: " << filename << " (" << path << ")" << endl;
+	}
+
+	int sourceId = NewSourceId();
+	m_fileIds.insert( make_pair( path, sourceId ) );
+	return sourceId;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineCache::GetCanonicalPath()
+
+	Returns the absolute path of a file, with symbolic links and "." and ".." components resolved,
+	or the filename unchanged if the file doesn't exist
+
+	@param		filename		Filename of the file
+*/
+/*************************************************************************************************/
+string LineCache::GetCanonicalPath( const string& filename )
+{
+	// Files in memory are only known by the names they were given
+
+	if ( GlobalData::Instance().GetVirtualFiles() != NULL )
+	{
+		return filename;
+	}
+
+#ifdef _WIN32
+	char* path = _fullpath( NULL, filename.c_str(), 0 );
+#else
+	char* path = realpath( filename.c_str(), NULL );
+#endif
+
+	if ( path == NULL )
+	{
+		return filename;
+	}
+
+	string canonicalPath( path );
+	free( path );
+	return canonicalPath;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineCache::NewSourceId()
+
+	Allocates an id for a source which isn't a file on disk (i.e. a macro body)
+*/
+/*************************************************************************************************/
+int LineCache::NewSourceId()
+{
+	m_sources.push_back( LineMap() );
+	m_buffers.push_back( NULL );
+	return static_cast< int >( m_sources.size() ) - 1;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineCache::LoadFile()
+
+	Returns the whole contents of a source file, reading it the first time it is asked for.  The
+	buffer is then shared by every subsequent include of the file and by the second pass.  The
+	start of each line is indexed as the file is read.
+
+	@param		sourceId		Id of the source, from GetSourceId()
+	@param		filename		Filename of the source file
+
+	If the file cannot be read, an AsmException will be thrown.
+*/
+/*************************************************************************************************/
+const SourceBuffer& LineCache::LoadFile( int sourceId, const string& filename )
+{
+	assert( sourceId >= 0 && sourceId < static_cast< int >( m_buffers.size() ) );
+
+	if ( m_buffers[ sourceId ] != NULL )
+	{
+		return *m_buffers[ sourceId ];
+	}
+
+	const VirtualFiles* pVirtualFiles = GlobalData::Instance().GetVirtualFiles();
+	SharedFiles* pSharedFiles = GlobalData::Instance().GetSharedFiles();
+	SourceBuffer* buffer = new SourceBuffer;
+	string& text = buffer->m_text;
+
+	if ( pVirtualFiles != NULL || pSharedFiles != NULL )
+	{
+		const string* pContents = ( pVirtualFiles != NULL ) ? pVirtualFiles->Find( filename ) : pSharedFiles->Read( filename );
+
+		if ( pContents == NULL )
+		{
+			delete buffer;
+			throw AsmException_FileError_OpenSourceFile( filename );
+		}
+
+		text = *pContents;
+	}
+	else
+	{
+		ifstream file( filename.c_str(), ios_base::binary );
+
+		if ( !file )
+		{
+			delete buffer;
+			throw AsmException_FileError_OpenSourceFile( filename );
+		}
+
+		char chunk[ 16384 ];
+
+		while ( file.read( chunk, sizeof chunk ) || file.gcount() > 0 )
+		{
+			text.append( chunk, static_cast< size_t >( file.gcount() ) );
+		}
+
+		if ( !file.eof() )
+		{
+			delete buffer;
+			throw AsmException_FileError_ReadSourceFile( filename );
+		}
+	}
+
+	m_buffers[ sourceId ] = buffer;
+	return *buffer;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineCache::Find()
+
+	Returns the cached line starting at the given file pointer of a source, or NULL if it has not
+	yet been read
+
+	@param		sourceId		Id of the source, from GetSourceId() or NewSourceId()
+	@param		filePointer		File pointer of the start of the line
+*/
+/*************************************************************************************************/
+SourceLine* LineCache::Find( int sourceId, int filePointer )
+{
+	assert( sourceId >= 0 && sourceId < static_cast< int >( m_sources.size() ) );
+
+	LineMap& lines = m_sources[ sourceId ];
+	LineMap::iterator it = lines.find( filePointer );
+
+	return ( it != lines.end() ) ? it->second : NULL;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineCache::Add()
+
+	Adds a newly read line to the cache
+
+	@param		sourceId		Id of the source, from GetSourceId() or NewSourceId()
+	@param		filePointer		File pointer of the start of the line
+	@param		text			The line, with tabs already expanded
+	@param		nextFilePointer	File pointer of the line which follows it
+*/
+/*************************************************************************************************/
+SourceLine* LineCache::Add( int sourceId, int filePointer, const string& text, int nextFilePointer )
+{
+	assert( Find( sourceId, filePointer ) == NULL );
+
+	SourceLine* line = new SourceLine( text, nextFilePointer );
+	m_sources[ sourceId ].insert( make_pair( filePointer, line ) );
+	return line;
+}
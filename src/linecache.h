@@ -0,0 +1,164 @@
+/*************************************************************************************************/
+/**
+	linecache.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef LINECACHE_H_
+#define LINECACHE_H_
+
+#include <cassert>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include "assemblycontext.h"
+#include "lineparser.h"
+
+
+// An expression which has been parsed once, reduced to the sequence of stack operations which
+// evaluating it performs.  The sequence only depends on the text of the expression, so it can be
+// replayed on subsequent passes and loop iterations without parsing the text again.
+
+struct CompiledExpression
+{
+	enum OPCODE
+	{
+		PUSH_CONSTANT,
+		PUSH_PC,
+		PUSH_SYMBOL,
+		APPLY_OPERATOR
+	};
+
+	struct Instruction
+	{
+		OPCODE				m_opcode;
+		double				m_value;				// PUSH_CONSTANT
+		int					m_symbol;				// PUSH_SYMBOL: index into m_symbols
+		unsigned int		m_nameHash;				// PUSH_SYMBOL: SymbolTable::Hash() of the name
+		mutable int			m_cachedScope;			// PUSH_SYMBOL: scope the symbol was last resolved from,
+		mutable int			m_cachedHandle;			// the handle found there (or -1), and the symbol
+		mutable unsigned int	m_cachedGeneration;	// table generation it is valid for
+		int					m_bracketCount;			// PUSH_SYMBOL: brackets open at the symbol
+		size_t				m_column;				// PUSH_SYMBOL: start of the symbol name
+													// APPLY_OPERATOR: column the operator is applied at
+		size_t				m_endColumn;			// PUSH_SYMBOL: end of the symbol name
+		void ( LineParser::*m_handler )();			// APPLY_OPERATOR
+	};
+
+	CompiledExpression( size_t column, bool bAllowOneMismatchedCloseBracket );
+
+	void AddConstant( double value );
+	void AddPC();
+	void AddSymbol( const std::string& symbolName, size_t column, size_t endColumn, int bracketCount );
+	void AddOperator( void ( LineParser::*handler )(), size_t column );
+
+	size_t						m_column;
+	bool						m_bAllowOneMismatchedCloseBracket;
+	size_t						m_endColumn;
+	std::vector< Instruction >	m_program;
+	std::vector< std::string >	m_symbols;
+};
+
+
+
+class SourceLine
+{
+public:
+
+	// The lexed form of the head of one statement: whether it is a symbol assignment, and if
+	// not, which entry of the token table (if any) it starts with
+
+	struct Statement
+	{
+		size_t				m_column;
+		size_t				m_tokenEndColumn;
+		int					m_token;
+		bool				m_isSymbolAssignment;
+	};
+
+	SourceLine( const std::string& text, int nextFilePointer );
+	~SourceLine();
+
+	inline const std::string&	GetText() const					{ return m_text; }
+	inline int					GetNextFilePointer() const		{ return m_nextFilePointer; }
+
+	const Statement*			FindStatement( size_t column ) const;
+	const Statement*			AddStatement( const Statement& statement );
+
+	const CompiledExpression*	FindExpression( size_t column, bool bAllowOneMismatchedCloseBracket ) const;
+	void						AddExpression( CompiledExpression* expression );
+
+
+private:
+
+	SourceLine( const SourceLine& );
+	SourceLine& operator=( const SourceLine& );
+
+	std::string							m_text;
+	int									m_nextFilePointer;
+	std::vector< Statement >			m_statements;
+	std::vector< CompiledExpression* >	m_expressions;
+};
+
+
+
+// The contents of a source file, which never change once it has been read.  Its lines are indexed
+// by file pointer in the line cache as they are first processed.
+
+struct SourceBuffer
+{
+	std::string					m_text;
+};
+
+
+
+class LineCache
+{
+public:
+
+	static void Create();
+	static void Destroy();
+	static inline LineCache& Instance() { assert( AssemblyContext::Current().m_pLineCache != NULL ); return *AssemblyContext::Current().m_pLineCache; }
+
+	int				GetSourceId( const std::string& filename );
+	int				NewSourceId();
+
+	const SourceBuffer&	LoadFile( int sourceId, const std::string& filename );
+
+	SourceLine*		Find( int sourceId, int filePointer );
+	SourceLine*		Add( int sourceId, int filePointer, const std::string& text, int nextFilePointer );
+
+
+private:
+
+	typedef std::map< int, SourceLine* >	LineMap;
+
+	LineCache();
+	~LineCache();
+
+	static std::string	GetCanonicalPath( const std::string& filename );
+
+	std::vector< LineMap >					m_sources;
+	std::vector< SourceBuffer* >			m_buffers;
+	std::map< std::string, int >			m_fileIds;		// keyed by canonical path
+};
+
+
+#endif // LINECACHE_H_
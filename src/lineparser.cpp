@@ -22,6 +22,7 @@
 */
 /*************************************************************************************************/
 
+#include <algorithm>
 #include <iostream>
 #include "lineparser.h"
 #include "asmexception.h"
@@ -29,6 +30,11 @@
 #include "symboltable.h"
 #include "globaldata.h"
 #include "sourcefile.h"
+#include "linecache.h"
+#include "singlepass.h"
+#include "objectcode.h"
+#include "statistics.h"
+#include "instrumentation.h"
 
 
 using namespace std;
@@ -42,10 +48,15 @@ using namespace std;
 	Constructor for LineParser
 */
 /*************************************************************************************************/
-LineParser::LineParser( SourceCode* sourceCode, string line )
+LineParser::LineParser( SourceCode* sourceCode, SourceLine& sourceLine )
 	:	m_sourceCode( sourceCode ),
-		m_line( line ),
-		m_column( 0 )
+		m_sourceLine( &sourceLine ),
+		m_line( sourceLine.GetText() ),
+		m_column( 0 ),
+		m_pCompiledExpression( NULL ),
+		m_bUndefinedSymbol( false ),
+		m_undefinedSymbolColumn( 0 ),
+		m_pDeferredExpression( NULL )
 {
 }
 
@@ -79,51 +90,34 @@ void LineParser::Process()
 
 		int oldColumn = m_column;
 
-		// Priority: check if it's symbol assignment and let it take priority over keywords
-		// This means symbols can begin with reserved words, e.g. PLAyer, but in the case of
-		// the line 'player = 1', the meaning is unambiguous, so we allow it as a symbol
-		// assignment.
+		// Find out what the statement starts with; this is only worked out the first time the
+		// statement is seen, and is replayed from the line cache thereafter
 
-		bool bIsSymbolAssignment = false;
+		bool bIsSymbolAssignment;
+		int token;
 
-		if ( isalpha( m_line[ m_column ] ) || m_line[ m_column ] == '_' )
-		{
-			do
-			{
-				m_column++;
+		LexStatement( bIsSymbolAssignment, token );
 
-			} while ( m_column < m_line.length() &&
-					  ( isalpha( m_line[ m_column ] ) ||
-						isdigit( m_line[ m_column ] ) ||
-						m_line[ m_column ] == '_' ||
-						m_line[ m_column ] == '%' ) &&
-						m_line[ m_column - 1 ] != '%' );
+		if ( token != -1 )
+		{
+			Statistics* pStatistics = Statistics::Get();
 
-			if ( AdvanceAndCheckEndOfStatement() )
+			if ( pStatistics != NULL )
 			{
-				if ( m_line[ m_column ] == '=' )
-				{
-					// if we have a valid symbol name, followed by an '=', it is definitely
-					// a symbol assignment.
-					bIsSymbolAssignment = true;
-				}
-			}
-		}
+				unsigned long bytesPut = ObjectCode::Instance().GetNumBytesPut();
+				unsigned long bytesCounted = pStatistics->GetNumBytesCounted();
 
-		m_column = oldColumn;
-
-		// first check tokens - they have priority over opcodes, so that they can have names
-		// like INCLUDE (which would otherwise be interpreted as INC LUDE)
-
-		if ( !bIsSymbolAssignment )
-		{
-			int token = GetTokenAndAdvanceColumn();
+				HandleToken( token, oldColumn );
 
-			if ( token != -1 )
+				pStatistics->AddDirective( m_gaTokenTable[ token ].m_pName,
+										   ObjectCode::Instance().GetNumBytesPut() - bytesPut -
+										   ( pStatistics->GetNumBytesCounted() - bytesCounted ) );
+			}
+			else
 			{
 				HandleToken( token, oldColumn );
-				continue;
 			}
+			continue;
 		}
 
 		// Next we see if we should even be trying to execute anything.... maybe the if condition is false
@@ -140,11 +134,25 @@ void LineParser::Process()
 
 		if ( !bIsSymbolAssignment )
 		{
-			int token = GetInstructionAndAdvanceColumn();
+			int instruction = GetInstructionAndAdvanceColumn();
 
-			if ( token != -1 )
+			if ( instruction != -1 )
 			{
-				HandleAssembler( token );
+				Statistics* pStatistics = Statistics::Get();
+
+				if ( pStatistics != NULL )
+				{
+					unsigned long bytesPut = ObjectCode::Instance().GetNumBytesPut();
+
+					HandleAssembler( instruction );
+
+					pStatistics->AddDirective( m_gaOpcodeTable[ instruction ].m_pName,
+											   ObjectCode::Instance().GetNumBytesPut() - bytesPut );
+				}
+				else
+				{
+					HandleAssembler( instruction );
+				}
 				continue;
 			}
 		}
@@ -154,7 +162,8 @@ void LineParser::Process()
 			// Deal here with symbol assignment
 			bool bIsConditionalAssignment = false;
 
-			string symbolName = GetSymbolName() + m_sourceCode->GetSymbolNameSuffix();
+			int scope = m_sourceCode->GetDefinitionScope();
+			string symbolName = GetSymbolName();
 
 			if ( !AdvanceAndCheckEndOfStatement() )
 			{
@@ -176,11 +185,11 @@ void LineParser::Process()
 
 			double value = EvaluateExpression();
 
-			if ( GlobalData::Instance().IsFirstPass() )
+			if ( GlobalData::Instance().IsDefiningPass() )
 			{
 				// only add the symbol on the first pass
 
-				if ( SymbolTable::Instance().IsSymbolDefined( symbolName ) )
+				if ( SymbolTable::Instance().IsSymbolDefined( scope, symbolName ) )
 				{
 					if (!bIsConditionalAssignment)
 					{
@@ -189,7 +198,12 @@ void LineParser::Process()
 				}
 				else
 				{
-					SymbolTable::Instance().AddSymbol( symbolName, value );
+					if ( GlobalData::Instance().IsSinglePass() )
+					{
+						SinglePass::Instance().CheckDefinition( scope, symbolName );
+					}
+
+					SymbolTable::Instance().AddSymbol( scope, symbolName, value );
 				}
 			}
 
@@ -219,14 +233,22 @@ void LineParser::Process()
 
 				for ( int i = 0; i < macro->GetNumberOfParameters(); i++ )
 				{
-					string paramName = macro->GetParameter( i ) + m_sourceCode->GetSymbolNameSuffix();
+					int scope = m_sourceCode->GetDefinitionScope();
+					const string& paramName = macro->GetParameter( i );
 
 					try
 					{
-						if ( !SymbolTable::Instance().IsSymbolDefined( paramName ) )
+						if ( !SymbolTable::Instance().IsSymbolDefined( scope, paramName ) )
 						{
+							size_t argumentColumn = m_column;
 							double value = EvaluateExpression();
-							SymbolTable::Instance().AddSymbol( paramName, value );
+
+							if ( GlobalData::Instance().IsSinglePass() )
+							{
+								CheckMacroArgument( *macro, i, argumentColumn );
+							}
+
+							SymbolTable::Instance().AddSymbol( scope, paramName, value );
 						}
 						else if ( GlobalData::Instance().IsSecondPass() )
 						{
@@ -235,9 +257,9 @@ void LineParser::Process()
 							// evaluate the inner macro parameter using the old value of the inner
 							// macro parameter rather than the new value of the outer macro
 							// parameter. See local-forward-branch-5.6502 for an example.
-							SymbolTable::Instance().RemoveSymbol( paramName );
+							SymbolTable::Instance().RemoveSymbol( scope, paramName );
 							double value = EvaluateExpression();
-							SymbolTable::Instance().AddSymbol( paramName, value );
+							SymbolTable::Instance().AddSymbol( scope, paramName, value );
 						}
 					}
 					catch ( AsmException_SyntaxError_SymbolNotDefined& )
@@ -265,7 +287,15 @@ void LineParser::Process()
 				}
 
 				MacroInstance macroInstance( macro, m_sourceCode );
-				macroInstance.Process();
+
+				{
+					InstrumentedSource instrumentedSource( macroName, true, macroInstance );
+					macroInstance.Process();
+				}
+
+				// The macro may have given scopes to the levels of the FOR stack it was passed
+
+				m_sourceCode->CopyForStack( &macroInstance );
 
 				HandleCloseBrace();
 
@@ -286,6 +316,118 @@ void LineParser::Process()
 
 
 
+/*************************************************************************************************/
+/**
+	LineParser::CheckMacroArgument()
+
+	In single pass mode, checks that a macro argument doesn't refer to a later parameter of the
+	same macro: on the second pass, that parameter would still hold the value it was given on the
+	first pass, so the argument could evaluate differently.
+
+	@param		macro			The macro being instantiated
+	@param		parameter		Index of the parameter the argument is for
+	@param		column			Column at which the argument starts
+*/
+/*************************************************************************************************/
+void LineParser::CheckMacroArgument( const Macro& macro, int parameter, size_t column ) const
+{
+	const CompiledExpression* argument = m_sourceLine->FindExpression( column, false );
+	assert( argument != NULL );
+
+	for ( int i = parameter + 1; i < macro.GetNumberOfParameters(); i++ )
+	{
+		if ( find( argument->m_symbols.begin(), argument->m_symbols.end(), macro.GetParameter( i ) ) != argument->m_symbols.end() )
+		{
+			throw AsmException_SinglePassFailed();
+		}
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	LineParser::LexStatement()
+
+	Classifies the statement starting at the current column, as either a symbol assignment, a
+	token from the token table, or neither.  If it is a token, the column is moved past it.
+
+	The result depends only on the text of the line, so it is cached in the SourceLine and
+	subsequent passes and loop iterations don't need to rescan it.
+
+	@param		bIsSymbolAssignment		Receives whether the statement is a symbol assignment
+	@param		token					Receives the token number, or -1 for "not a token"
+*/
+/*************************************************************************************************/
+void LineParser::LexStatement( bool& bIsSymbolAssignment, int& token )
+{
+	const SourceLine::Statement* statement = m_sourceLine->FindStatement( m_column );
+
+	if ( statement == NULL )
+	{
+		SourceLine::Statement newStatement;
+
+		newStatement.m_column = m_column;
+		newStatement.m_isSymbolAssignment = false;
+
+		// Priority: check if it's symbol assignment and let it take priority over keywords
+		// This means symbols can begin with reserved words, e.g. PLAyer, but in the case of
+		// the line 'player = 1', the meaning is unambiguous, so we allow it as a symbol
+		// assignment.
+
+		if ( isalpha( m_line[ m_column ] ) || m_line[ m_column ] == '_' )
+		{
+			do
+			{
+				m_column++;
+
+			} while ( m_column < m_line.length() &&
+					  ( isalpha( m_line[ m_column ] ) ||
+						isdigit( m_line[ m_column ] ) ||
+						m_line[ m_column ] == '_' ||
+						m_line[ m_column ] == '%' ) &&
+						m_line[ m_column - 1 ] != '%' );
+
+			if ( AdvanceAndCheckEndOfStatement() )
+			{
+				if ( m_line[ m_column ] == '=' )
+				{
+					// if we have a valid symbol name, followed by an '=', it is definitely
+					// a symbol assignment.
+					newStatement.m_isSymbolAssignment = true;
+				}
+			}
+		}
+
+		m_column = newStatement.m_column;
+
+		// first check tokens - they have priority over opcodes, so that they can have names
+		// like INCLUDE (which would otherwise be interpreted as INC LUDE)
+
+		newStatement.m_token = -1;
+
+		if ( !newStatement.m_isSymbolAssignment )
+		{
+			newStatement.m_token = GetTokenAndAdvanceColumn();
+		}
+
+		newStatement.m_tokenEndColumn = m_column;
+		m_column = newStatement.m_column;
+
+		statement = m_sourceLine->AddStatement( newStatement );
+	}
+
+	bIsSymbolAssignment = statement->m_isSymbolAssignment;
+	token = statement->m_token;
+
+	if ( token != -1 )
+	{
+		m_column = statement->m_tokenEndColumn;
+	}
+}
+
+
+
 /*************************************************************************************************/
 /**
 	LineParser::SkipStatement()
@@ -24,8 +24,13 @@
 #define LINEPARSER_H_
 
 #include <string>
+#include <vector>
+#include "singlepass.h"
 
+class Macro;
 class SourceCode;
+class SourceLine;
+struct CompiledExpression;
 
 class LineParser
 {
@@ -33,13 +38,18 @@ public:
 
 	// Constructor/destructor
 
-	LineParser( SourceCode* sourceCode, std::string line );
+	LineParser( SourceCode* sourceCode, SourceLine& sourceLine );
 	~LineParser();
 
 	// Process the line
 
 	void Process();
 
+	// Single pass mode support
+
+	static CompiledExpression* FoldExpression( const CompiledExpression& expression, int scope );
+	static double	EvaluateFoldedExpression( SourceLine& sourceLine, const CompiledExpression& expression );
+
 	// Accessors
 
 
@@ -55,6 +65,18 @@ private:
 		DirectiveHandler	m_directiveHandler;
 	};
 
+	struct TokenIndex
+	{
+		TokenIndex();
+
+		// Token numbers grouped by first character, in table order within each group, so
+		// m_tokens[ m_aFirst[ c ] ] to m_tokens[ m_aFirst[ c + 1 ] - 1 ] all begin with c
+
+		int						m_aFirst[ 257 ];
+		std::vector< int >		m_tokens;
+		std::vector< size_t >	m_lengths;
+	};
+
 	enum ADDRESSING_MODE
 	{
 		IMP,
@@ -83,6 +105,21 @@ private:
 		int				m_cpu;
 	};
 
+	struct OpcodeIndex
+	{
+		OpcodeIndex();
+
+		enum
+		{
+			NUM_CPUS		= 2,
+			NUM_MNEMONICS	= 26 * 26 * 26
+		};
+
+		// For each CPU, the opcode table entry for every possible 3-letter mnemonic, or -1
+
+		short			m_aInstructions[ NUM_CPUS ][ NUM_MNEMONICS ];
+	};
+
 
 	typedef void ( LineParser::*OperatorHandler )();
 
@@ -102,10 +139,14 @@ private:
 
 	// line parsing methods
 
+	void			LexStatement( bool& bIsSymbolAssignment, int& token );
 	int				GetTokenAndAdvanceColumn();
+	static const TokenIndex& GetTokenIndex();
 	void			HandleToken( int i, int oldColumn );
 	int				GetInstructionAndAdvanceColumn();
+	static const OpcodeIndex& GetOpcodeIndex();
 	int				CheckMacroMatches();
+	void			CheckMacroArgument( const Macro& macro, int parameter, size_t column ) const;
 	bool			MoveToNextAtom( const char* pTerminators = NULL );
 	bool			AdvanceAndCheckEndOfLine();
 	bool			AdvanceAndCheckEndOfStatement();
@@ -166,7 +207,16 @@ private:
 	double			EvaluateExpression( bool bAllowOneMismatchedCloseBracket = false );
 	int				EvaluateExpressionAsInt( bool bAllowOneMismatchedCloseBracket = false );
 	unsigned int	EvaluateExpressionAsUnsignedInt( bool bAllowOneMismatchedCloseBracket = false );
+	double			InterpretExpression( bool bAllowOneMismatchedCloseBracket );
+	double			RunCompiledExpression( const CompiledExpression& expression );
+	void			ApplyOperator( OperatorHandler handler );
 	double			GetValue();
+	double			GetDecimalLiteral();
+	unsigned int	GetHexLiteral();
+	bool			LookUpSymbol( const std::string& symbolName, double& value ) const;
+	bool			LookUpSymbol( const CompiledExpression& expression, size_t instruction, double& value ) const;
+	void			NoteUndefinedSymbol( size_t column );
+	void			AddFixup( SinglePass::FIXUP_TYPE type );
 
 	void			EvalAdd();
 	void			EvalSubtract();
@@ -211,7 +261,8 @@ private:
 
 
 	SourceCode*				m_sourceCode;
-	std::string				m_line;
+	SourceLine*				m_sourceLine;
+	const std::string&		m_line;				// the text held by m_sourceLine, not a copy
 	size_t					m_column;
 
 	static const Token		m_gaTokenTable[];
@@ -226,6 +277,15 @@ private:
 	Operator				m_operatorStack[ MAX_OPERATORS ];
 	int						m_valueStackPtr;
 	int						m_operatorStackPtr;
+
+	CompiledExpression*		m_pCompiledExpression;	// the expression being compiled, if any
+
+	// Single pass mode: whether the expression being evaluated refers to an undefined symbol, and
+	// the expression which the caller should record a fixup for
+
+	bool					m_bUndefinedSymbol;
+	size_t					m_undefinedSymbolColumn;
+	const CompiledExpression* m_pDeferredExpression;
 };
 
 
@@ -20,16 +20,18 @@
 */
 /*************************************************************************************************/
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
 #include "macro.h"
+#include "linecache.h"
+#include "stringutils.h"
 
 
 using namespace std;
 
 
-MacroTable* MacroTable::m_gInstance = NULL;
 
 
 /*************************************************************************************************/
@@ -44,7 +46,8 @@ MacroTable* MacroTable::m_gInstance = NULL;
 /*************************************************************************************************/
 Macro::Macro( const string& filename, int lineNumber )
 	:	m_filename( filename ),
-		m_lineNumber( lineNumber )
+		m_lineNumber( lineNumber ),
+		m_sourceId( LineCache::Instance().NewSourceId() )
 {
 }
 
@@ -52,80 +55,133 @@ Macro::Macro( const string& filename, int lineNumber )
 
 /*************************************************************************************************/
 /**
-	MacroInstance::MacroInstance()
-
-	Constructor for MacroInstance
+	Macro::SplitBody()
 
-	@param		macro			Macro definition to instance
+	Called once the whole macro has been defined, at ENDMACRO.  Splits the body into lines and
+	adds them to the line cache, so that each invocation just steps through them, and lexes and
+	compiles each line only the first time it is run.
 */
 /*************************************************************************************************/
-MacroInstance::MacroInstance( const Macro* macro, const SourceCode* sourceCode )
-	:	SourceCode( macro->GetFilename(), macro->GetLineNumber() ),
-		m_stream( macro->GetBody() )
-		//,m_macro( macro )
+void Macro::SplitBody()
 {
-//	cout << "Instance macro: " << m_macro->GetName() << " (" << m_filename << ":" << m_lineNumber << ")" << endl;
+	assert( m_lines.empty() );
 
-	// Copy FOR stack from the parent
+	size_t start = 0;
 
-	CopyForStack( sourceCode );
-}
+	while ( start < m_body.length() )
+	{
+		size_t end = m_body.find( '\n', start );
 
+		if ( end == string::npos )
+		{
+			end = m_body.length();
+		}
 
+		string line( m_body, start, end - start );
 
-/*************************************************************************************************/
-/**
-	MacroInstance::GetLine()
+		// Convert tabs to spaces
 
-	Reads a line from the source code and returns it into lineFromFile
-*/
-/*************************************************************************************************/
-istream& MacroInstance::GetLine( string& lineFromFile ) 
-{
-	return getline( m_stream, lineFromFile );
+		StringUtils::ExpandTabsToSpaces( line, 8 );
+
+		int offset = static_cast< int >( start );
+		int nextOffset = static_cast< int >( min( end + 1, m_body.length() ) );
+
+		m_lineOffsets.push_back( offset );
+		m_lines.push_back( LineCache::Instance().Add( m_sourceId, offset, line, nextOffset ) );
+
+		start = end + 1;
+	}
 }
 
 
 
 /*************************************************************************************************/
 /**
-	MacroInstance::GetFilePointer()
+	Macro::FindLine()
 
-	Returns the current file pointer
+	Finds the line of the body which starts at the given offset
+
+	@param		offset			Offset into the body
+
+	@return		int				Index of the line, or -1 if no line starts there
 */
 /*************************************************************************************************/
-int MacroInstance::GetFilePointer()
+int Macro::FindLine( int offset ) const
 {
-	return static_cast< int >( m_stream.tellg() );
+	vector< int >::const_iterator it = lower_bound( m_lineOffsets.begin(), m_lineOffsets.end(), offset );
+
+	if ( it == m_lineOffsets.end() || *it != offset )
+	{
+		return -1;
+	}
+
+	return static_cast< int >( it - m_lineOffsets.begin() );
 }
 
 
 
 /*************************************************************************************************/
 /**
-	MacroInstance::SetFilePointer()
+	MacroInstance::MacroInstance()
+
+	Constructor for MacroInstance
 
-	Sets the current file pointer
+	@param		macro			Macro definition to instance
 */
 /*************************************************************************************************/
-void MacroInstance::SetFilePointer( int i )
+MacroInstance::MacroInstance( const Macro* macro, const SourceCode* sourceCode )
+	:	SourceCode( macro->GetFilename(), macro->GetLineNumber(), macro->GetSourceId() ),
+		m_macro( macro ),
+		m_lineIndex( 0 )
 {
-	m_lineStartPointer = i;
-	m_stream.seekg( i );
+	m_pBuffer = &macro->GetBody();
+
+//	cout << "Instance macro: " << m_macro->GetName() << " (" << m_filename << ":" << m_lineNumber << ")" << endl;
+
+	// Copy FOR stack from the parent
+
+	CopyForStack( sourceCode );
 }
 
 
 
 /*************************************************************************************************/
 /**
-	MacroInstance::IsAtEnd()
+	MacroInstance::GetSourceLine()
+
+	Returns the line of the macro body starting at the given file pointer.  Normally this is just
+	the next line of the split body.
+
+	@param		filePointer		Offset into the macro body
 
-	Returns whether the current stream is in an end-of-file state
+	@return		SourceLine*		The line, or NULL at the end of the macro
 */
 /*************************************************************************************************/
-bool MacroInstance::IsAtEnd()
+SourceLine* MacroInstance::GetSourceLine( int filePointer )
 {
-	return m_stream.eof();
+	if ( m_lineIndex < m_macro->GetNumberOfLines() &&
+		 m_macro->GetLineOffset( m_lineIndex ) == filePointer )
+	{
+		return m_macro->GetLine( m_lineIndex++ );
+	}
+
+	if ( filePointer >= static_cast< int >( m_pBuffer->length() ) )
+	{
+		return NULL;
+	}
+
+	// Otherwise a FOR loop has jumped back, either to the start of a line, or part way into one
+	// (when the FOR isn't the first statement on its line), which is read from the body as usual
+
+	int lineIndex = m_macro->FindLine( filePointer );
+
+	if ( lineIndex >= 0 )
+	{
+		m_lineIndex = lineIndex + 1;
+		return m_macro->GetLine( lineIndex );
+	}
+
+	return SourceCode::GetSourceLine( filePointer );
 }
 
 
@@ -139,9 +195,9 @@ bool MacroInstance::IsAtEnd()
 /*************************************************************************************************/
 void MacroTable::Create()
 {
-	assert( m_gInstance == NULL );
+	assert( AssemblyContext::Current().m_pMacroTable == NULL );
 
-	m_gInstance = new MacroTable;
+	AssemblyContext::Current().m_pMacroTable = new MacroTable;
 }
 
 
@@ -155,10 +211,10 @@ void MacroTable::Create()
 /*************************************************************************************************/
 void MacroTable::Destroy()
 {
-	assert( m_gInstance != NULL );
+	assert( AssemblyContext::Current().m_pMacroTable != NULL );
 
-	delete m_gInstance;
-	m_gInstance = NULL;
+	delete AssemblyContext::Current().m_pMacroTable;
+	AssemblyContext::Current().m_pMacroTable = NULL;
 }
 
 
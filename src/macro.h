@@ -29,8 +29,11 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include "assemblycontext.h"
 #include "sourcecode.h"
 
+class SourceLine;
+
 
 class Macro
 {
@@ -74,6 +77,25 @@ public:
 		return m_body;
 	}
 
+	void SplitBody();
+
+	int GetNumberOfLines() const
+	{
+		return m_lines.size();
+	}
+
+	int GetLineOffset( int i ) const
+	{
+		return m_lineOffsets[ i ];
+	}
+
+	SourceLine* GetLine( int i ) const
+	{
+		return m_lines[ i ];
+	}
+
+	int FindLine( int offset ) const;
+
 	const std::string& GetFilename() const
 	{
 		return m_filename;
@@ -84,15 +106,23 @@ public:
 		return m_lineNumber;
 	}
 
+	int GetSourceId() const
+	{
+		return m_sourceId;
+	}
+
 
 private:
 
 	std::string						m_filename;
 	int								m_lineNumber;
+	int								m_sourceId;
 
 	std::string						m_name;
 	std::vector< std::string >		m_parameters;
 	std::string						m_body;
+	std::vector< int >				m_lineOffsets;
+	std::vector< SourceLine* >		m_lines;		// owned by the LineCache
 
 };
 
@@ -104,18 +134,13 @@ public:
 	MacroInstance( const Macro* macro, const SourceCode* parent );
 	virtual ~MacroInstance() {}
 
-	// Accessors
-
-	virtual int						GetFilePointer();
-	virtual void					SetFilePointer( int i );
-	virtual std::istream&			GetLine( std::string& lineFromFile );
-	virtual bool					IsAtEnd();
+	virtual SourceLine*		GetSourceLine( int filePointer );
 
 
 private:
 
-	std::istringstream				m_stream;
-	//const Macro*					m_macro;
+	const Macro*					m_macro;
+	int								m_lineIndex;
 };
 
 
@@ -126,7 +151,7 @@ public:
 
 	static void Create();
 	static void Destroy();
-	static inline MacroTable& Instance() { assert( m_gInstance != NULL ); return *m_gInstance; }
+	static inline MacroTable& Instance() { assert( AssemblyContext::Current().m_pMacroTable != NULL ); return *AssemblyContext::Current().m_pMacroTable; }
 
 	void Add( Macro* macro );
 	bool Exists( const std::string& name ) const;
@@ -138,8 +163,6 @@ private:
 	~MacroTable();
 
 	std::map< std::string, Macro* >	m_map;
-
-	static MacroTable*				m_gInstance;
 };
 
 
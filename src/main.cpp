@@ -23,9 +23,14 @@
 /*************************************************************************************************/
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <cstring>
 #include <cstdlib>
 #include <ctime>
+#include <vector>
+#include <algorithm>
+#include <thread>
 
 #include "main.h"
 #include "sourcefile.h"
@@ -37,6 +42,13 @@
 #include "BASIC.h"
 #include "macro.h"
 #include "random.h"
+#include "assemblycontext.h"
+#include "assemblycache.h"
+#include "assembly.h"
+#include "variants.h"
+#include "statistics.h"
+#include "profiler.h"
+#include "tracer.h"
 
 
 using namespace std;
@@ -45,6 +57,112 @@ using namespace std;
 #define VERSION "1.09"
 
 
+// Options which can't change the result of an assembly, only where its side products go, so are
+// left out of the options which identify it in the cache
+
+static const struct
+{
+	const char*		m_pName;
+	bool			m_bHasArgument;
+}
+s_aOutputNeutralOptions[] =
+{
+	{ "-M",					true },
+	{ "-cache",				true },
+	{ "--stats",			false },
+	{ "--stats-json",		true },
+	{ "--profile",			true },
+	{ "--profile-folded",	true },
+	{ "--trace",			true }
+};
+
+
+
+/*************************************************************************************************/
+/**
+	EscapeDependencyPath()
+
+	Escapes a filename so that make and ninja read it back as a single path
+
+	@param		path			Filename to escape
+
+	@return		string			Escaped filename
+*/
+/*************************************************************************************************/
+static string EscapeDependencyPath( const string& path )
+{
+	string escaped;
+
+	for ( string::const_iterator it = path.begin(); it != path.end(); ++it )
+	{
+		if ( *it == ' ' || *it == '#' )
+		{
+			escaped += '\\';
+		}
+		else if ( *it == '$' )
+		{
+			escaped += '$';
+		}
+		escaped += *it;
+	}
+
+	return escaped;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	WriteDependencyFile()
+
+	Writes a make-style rule naming every file the assembly wrote as a target of every file it
+	read, followed by an empty rule for each input so that deleting one doesn't break the build.
+	If nothing was written, the dependency file itself is used as the target.
+
+	@param		pDepFile		Dependency filename
+
+	@return		bool			false if the file couldn't be written
+*/
+/*************************************************************************************************/
+static bool WriteDependencyFile( const char* pDepFile )
+{
+	ofstream depFile( pDepFile );
+
+	const vector< string >& inputs = GlobalData::Instance().GetInputFiles();
+	const vector< string >& outputs = GlobalData::Instance().GetOutputFiles();
+
+	if ( outputs.empty() )
+	{
+		depFile << EscapeDependencyPath( pDepFile );
+	}
+
+	for ( vector< string >::const_iterator it = outputs.begin(); it != outputs.end(); ++it )
+	{
+		depFile << ( it == outputs.begin() ? "" : " " ) << EscapeDependencyPath( *it );
+	}
+
+	depFile << ":";
+
+	for ( vector< string >::const_iterator it = inputs.begin(); it != inputs.end(); ++it )
+	{
+		depFile << " \\" << endl << " " << EscapeDependencyPath( *it );
+	}
+
+	depFile << endl;
+
+	for ( vector< string >::const_iterator it = inputs.begin(); it != inputs.end(); ++it )
+	{
+		depFile << endl << EscapeDependencyPath( *it ) << ":" << endl;
+	}
+
+	depFile.close();
+
+	return !depFile.fail();
+}
+
+
+
+
 /*************************************************************************************************/
 /**
 	main()
@@ -62,6 +180,11 @@ int main( int argc, char* argv[] )
 	const char* pOutputFile = NULL;
 	const char* pDiscInputFile = NULL;
 	const char* pDiscOutputFile = NULL;
+	const char* pDepFile = NULL;
+	const char* pCacheDir = NULL;
+	const char* pStatsFile = NULL;
+	const char* pFoldedStacksFile = NULL;
+	const char* pTraceFile = NULL;
 
 	enum STATES
 	{
@@ -73,19 +196,62 @@ int main( int argc, char* argv[] )
 		WAITING_FOR_BOOT_FILENAME,
 		WAITING_FOR_DISC_OPTION,
 		WAITING_FOR_DISC_TITLE,
-		WAITING_FOR_SYMBOL
+		WAITING_FOR_SYMBOL,
+		WAITING_FOR_DEPFILE,
+		WAITING_FOR_CACHE_DIR,
+		WAITING_FOR_VARIANTS_FILE,
+		WAITING_FOR_NUM_THREADS,
+		WAITING_FOR_STATS_FILE,
+		WAITING_FOR_NUM_HOTSPOTS,
+		WAITING_FOR_FOLDED_STACKS_FILE,
+		WAITING_FOR_TRACE_FILE
 
 	} state = READY;
 
 	bool bDumpSymbols = false;
-
-	GlobalData::Create();
-	SymbolTable::Create();
+	bool bVerbose = false;
+	bool bSinglePass = false;
+	bool bStats = false;
+	int numHotspots = 0;
+	vector< string > commandLineSymbols;
+	const char* pVariantsFile = NULL;
+	int numThreads = max( 1, static_cast< int >( thread::hardware_concurrency() ) );
+	vector< string > cacheOptions( 1, "beebasm " VERSION );
+	bool bSkipCacheArgument = false;
+
+	AssemblyContext context;
 
 	// Parse command line parameters
 
 	for ( int i = 1; i < argc; i++ )
 	{
+		if ( bSkipCacheArgument )
+		{
+			bSkipCacheArgument = false;
+		}
+		else
+		{
+			bool bAffectsOutput = true;
+
+			if ( state == READY )
+			{
+				for ( size_t j = 0; j < sizeof s_aOutputNeutralOptions / sizeof s_aOutputNeutralOptions[ 0 ]; j++ )
+				{
+					if ( strcmp( argv[i], s_aOutputNeutralOptions[ j ].m_pName ) == 0 )
+					{
+						bAffectsOutput = false;
+						bSkipCacheArgument = s_aOutputNeutralOptions[ j ].m_bHasArgument;
+						break;
+					}
+				}
+			}
+
+			if ( bAffectsOutput )
+			{
+				cacheOptions.push_back( argv[i] );
+			}
+		}
+
 		switch ( state )
 		{
 			case READY:
@@ -129,6 +295,7 @@ int main( int argc, char* argv[] )
 				else if ( strcmp( argv[i], "-v" ) == 0 )
 				{
 					GlobalData::Instance().SetVerbose( true );
+					bVerbose = true;
 				}
 				else if ( strcmp( argv[i], "-d" ) == 0 )
 				{
@@ -138,6 +305,46 @@ int main( int argc, char* argv[] )
 				{
 					state = WAITING_FOR_SYMBOL;
 				}
+				else if ( strcmp( argv[i], "-sp" ) == 0 )
+				{
+					bSinglePass = true;
+				}
+				else if ( strcmp( argv[i], "-M" ) == 0 )
+				{
+					state = WAITING_FOR_DEPFILE;
+				}
+				else if ( strcmp( argv[i], "-cache" ) == 0 )
+				{
+					state = WAITING_FOR_CACHE_DIR;
+				}
+				else if ( strcmp( argv[i], "-variants" ) == 0 )
+				{
+					state = WAITING_FOR_VARIANTS_FILE;
+				}
+				else if ( strcmp( argv[i], "-j" ) == 0 )
+				{
+					state = WAITING_FOR_NUM_THREADS;
+				}
+				else if ( strcmp( argv[i], "--stats" ) == 0 )
+				{
+					bStats = true;
+				}
+				else if ( strcmp( argv[i], "--stats-json" ) == 0 )
+				{
+					state = WAITING_FOR_STATS_FILE;
+				}
+				else if ( strcmp( argv[i], "--profile" ) == 0 )
+				{
+					state = WAITING_FOR_NUM_HOTSPOTS;
+				}
+				else if ( strcmp( argv[i], "--profile-folded" ) == 0 )
+				{
+					state = WAITING_FOR_FOLDED_STACKS_FILE;
+				}
+				else if ( strcmp( argv[i], "--trace" ) == 0 )
+				{
+					state = WAITING_FOR_TRACE_FILE;
+				}
 				else if ( strcmp( argv[i], "--help" ) == 0 )
 				{
 					cout << "beebasm " VERSION << endl << endl;
@@ -154,6 +361,16 @@ int main( int argc, char* argv[] )
 					cout << " -w             Require whitespace between opcodes and labels" << endl;
 					cout << " -vc            Use Visual C++-style error messages" << endl;
 					cout << " -D <sym>=<val> Define symbol prior to assembly" << endl;
+					cout << " -sp            Assemble in a single pass where possible" << endl;
+					cout << " -M <file>      Write a make/ninja dependency file listing all files read and written" << endl;
+					cout << " -cache <dir>   Reuse the result of an identical earlier assembly held in <dir>" << endl;
+					cout << " -variants <file> Assemble each variant listed in <file> into its own directory" << endl;
+					cout << " -j <n>         Number of threads to assemble variants on" << endl;
+					cout << " --stats        Report time taken by each pass, and counts of what was assembled" << endl;
+					cout << " --stats-json <file> Write the --stats report to <file> as JSON" << endl;
+					cout << " --profile <n>  Report the <n> source lines and macros which took longest to assemble" << endl;
+					cout << " --profile-folded <file> Write the time spent in each file, macro and FOR loop to <file>, for flame graphs" << endl;
+					cout << " --trace <file> Write a timeline of passes, files, macros, FOR loops and saves to <file>" << endl;
 					cout << " --help         See this help again" << endl;
 					return EXIT_SUCCESS;
 				}
@@ -226,6 +443,72 @@ int main( int argc, char* argv[] )
 					cerr << "Invalid -D expression: " << argv[i] << endl;
 					return EXIT_FAILURE;
 				}
+				commandLineSymbols.push_back( argv[i] );
+				state = READY;
+				break;
+
+			case WAITING_FOR_DEPFILE:
+
+				pDepFile = argv[i];
+				state = READY;
+				break;
+
+
+			case WAITING_FOR_CACHE_DIR:
+
+				pCacheDir = argv[i];
+				state = READY;
+				break;
+
+
+			case WAITING_FOR_VARIANTS_FILE:
+
+				pVariantsFile = argv[i];
+				state = READY;
+				break;
+
+
+			case WAITING_FOR_NUM_THREADS:
+
+				numThreads = std::strtol( argv[i], NULL, 10 );
+				if ( numThreads < 1 )
+				{
+					cerr << "Invalid number of threads: " << argv[i] << endl;
+					return EXIT_FAILURE;
+				}
+				state = READY;
+				break;
+
+
+			case WAITING_FOR_STATS_FILE:
+
+				pStatsFile = argv[i];
+				state = READY;
+				break;
+
+
+			case WAITING_FOR_NUM_HOTSPOTS:
+
+				numHotspots = std::strtol( argv[i], NULL, 10 );
+				if ( numHotspots < 1 )
+				{
+					cerr << "Invalid number of hotspots: " << argv[i] << endl;
+					return EXIT_FAILURE;
+				}
+				state = READY;
+				break;
+
+
+			case WAITING_FOR_FOLDED_STACKS_FILE:
+
+				pFoldedStacksFile = argv[i];
+				state = READY;
+				break;
+
+
+			case WAITING_FOR_TRACE_FILE:
+
+				pTraceFile = argv[i];
 				state = READY;
 				break;
 		}
@@ -254,47 +537,172 @@ int main( int argc, char* argv[] )
 	}
 
 
+	if ( pVariantsFile != NULL && ( bVerbose || bDumpSymbols || pDepFile != NULL || pCacheDir != NULL ||
+									bStats || pStatsFile != NULL || numHotspots > 0 || pFoldedStacksFile != NULL || pTraceFile != NULL ) )
+	{
+		cerr << "-variants can't be used with -v, -d, -M, -cache, --stats, --profile or --trace" << endl;
+		return EXIT_FAILURE;
+	}
+
+
 	// All good, start the assembling
 
 	int exitCode = EXIT_SUCCESS;
 
-	ObjectCode::Create();
-	MacroTable::Create();
 	SetupBASICTables();
 
-	time_t randomSeed = time( NULL );
+	AssemblyOptions options;
+	options.m_pInputFile = pInputFile;
+	options.m_pDiscInputFile = pDiscInputFile;
+	options.m_pDiscOutputFile = pDiscOutputFile;
+	options.m_symbols = commandLineSymbols;
+	options.m_bSinglePass = bSinglePass;
+	options.m_randomSeed = time( NULL );
+
+	if ( pVariantsFile != NULL )
+	{
+		VariantBuild build( options );
+
+		if ( !build.ReadVariants( pVariantsFile ) || !build.Run( numThreads ) )
+		{
+			exitCode = EXIT_FAILURE;
+		}
+
+		return exitCode;
+	}
 
-	DiscImage* pDiscIm = NULL;
+	// With a cache the result may not need assembling at all.  Otherwise everything printed is
+	// held back, so that it can be stored along with the files written.
 
-	try
+	AssemblyCache* pCache = NULL;
+	bool bRestored = false;
+	ostringstream output;
+	streambuf* pCoutBuffer = cout.rdbuf();
+
+	if ( pCacheDir != NULL )
+	{
+		pCache = new AssemblyCache( pCacheDir, cacheOptions );
+
+		string cachedOutput;
+		bRestored = pCache->Restore( cachedOutput );
+
+		if ( bRestored )
+		{
+			cout << cachedOutput;
+		}
+		else
+		{
+			cout.rdbuf( output.rdbuf() );
+		}
+	}
+
+	if ( !bRestored )
 	{
-		if ( GlobalData::Instance().UsesDiscImage() )
+		if ( bStats || pStatsFile != NULL )
+		{
+			Statistics::Create();
+		}
+
+		if ( numHotspots > 0 || pFoldedStacksFile != NULL )
+		{
+			Profiler::Create( pFoldedStacksFile != NULL );
+		}
+
+		if ( pTraceFile != NULL )
+		{
+			Tracer::Create();
+		}
+
+		if ( !Assemble( options, cerr ) )
+		{
+			exitCode = EXIT_FAILURE;
+		}
+
+		if ( bStats )
 		{
-			pDiscIm = new DiscImage( pDiscOutputFile, pDiscInputFile );
-			GlobalData::Instance().SetDiscImage( pDiscIm );
+			Statistics::Get()->Report( cerr );
 		}
 
-		for ( int pass = 0; pass < 2; pass++ )
+		if ( pStatsFile != NULL )
 		{
-			GlobalData::Instance().SetPass( pass );
-			ObjectCode::Instance().InitialisePass();
-			GlobalData::Instance().ResetForId();
-			beebasm_srand( static_cast< unsigned long >( randomSeed ) );
-			SourceFile input( pInputFile );
-			input.Process();
+			ofstream statsFile( pStatsFile );
+			Statistics::Get()->WriteJson( statsFile );
+			statsFile.close();
+
+			if ( statsFile.fail() )
+			{
+				cerr << "Could not write statistics file: " << pStatsFile << endl;
+				exitCode = EXIT_FAILURE;
+			}
+		}
+
+		if ( numHotspots > 0 )
+		{
+			Profiler::Get()->Report( cerr, numHotspots );
+		}
+
+		if ( pFoldedStacksFile != NULL )
+		{
+			ofstream foldedStacksFile( pFoldedStacksFile );
+			Profiler::Get()->WriteFoldedStacks( foldedStacksFile );
+			foldedStacksFile.close();
+
+			if ( foldedStacksFile.fail() )
+			{
+				cerr << "Could not write profile file: " << pFoldedStacksFile << endl;
+				exitCode = EXIT_FAILURE;
+			}
+		}
+
+		if ( pTraceFile != NULL )
+		{
+			ofstream traceFile( pTraceFile );
+			Tracer::Get()->Write( traceFile );
+			traceFile.close();
+
+			if ( traceFile.fail() )
+			{
+				cerr << "Could not write trace file: " << pTraceFile << endl;
+				exitCode = EXIT_FAILURE;
+			}
+		}
+
+		if ( bDumpSymbols && exitCode == EXIT_SUCCESS )
+		{
+			SymbolTable::Instance().Dump();
+		}
+
+		if ( pDiscInputFile != NULL )
+		{
+			GlobalData::Instance().AddInputFile( pDiscInputFile );
+		}
+
+		if ( pDiscOutputFile != NULL )
+		{
+			GlobalData::Instance().AddOutputFile( pDiscOutputFile );
 		}
 	}
-	catch ( AsmException& e )
+
+	if ( pCache != NULL && !bRestored )
 	{
-		e.Print();
-		exitCode = EXIT_FAILURE;
+		cout.rdbuf( pCoutBuffer );
+		cout << output.str();
+
+		if ( exitCode == EXIT_SUCCESS && GlobalData::Instance().IsRepeatable() )
+		{
+			pCache->Store( output.str() );
+		}
 	}
 
-	delete pDiscIm;
+	delete pCache;
 
-	if ( bDumpSymbols && exitCode == EXIT_SUCCESS )
+	if ( pDepFile != NULL && exitCode == EXIT_SUCCESS )
 	{
-		SymbolTable::Instance().Dump();
+		if ( !WriteDependencyFile( pDepFile ) )
+		{
+			cerr << "Could not write dependency file: " << pDepFile << endl;
+			exitCode = EXIT_FAILURE;
+		}
 	}
 
 	if ( !GlobalData::Instance().IsSaved() && exitCode == EXIT_SUCCESS )
@@ -302,10 +710,5 @@ int main( int argc, char* argv[] )
 		cerr << "warning: no SAVE command in source file." << endl;
 	}
 
-	MacroTable::Destroy();
-	ObjectCode::Destroy();
-	SymbolTable::Destroy();
-	GlobalData::Destroy();
-
 	return exitCode;
 }
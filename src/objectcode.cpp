@@ -20,17 +20,20 @@
 */
 /*************************************************************************************************/
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 #include "objectcode.h"
 #include "symboltable.h"
 #include "asmexception.h"
 #include "globaldata.h"
+#include "virtualfiles.h"
+#include "sharedfiles.h"
 
 
-ObjectCode* ObjectCode::m_gInstance = NULL;
 
 
 using namespace std;
@@ -45,9 +48,9 @@ using namespace std;
 /*************************************************************************************************/
 void ObjectCode::Create()
 {
-	assert( m_gInstance == NULL );
+	assert( AssemblyContext::Current().m_pObjectCode == NULL );
 
-	m_gInstance = new ObjectCode;
+	AssemblyContext::Current().m_pObjectCode = new ObjectCode;
 }
 
 
@@ -61,10 +64,10 @@ void ObjectCode::Create()
 /*************************************************************************************************/
 void ObjectCode::Destroy()
 {
-	assert( m_gInstance != NULL );
+	assert( AssemblyContext::Current().m_pObjectCode != NULL );
 
-	delete m_gInstance;
-	m_gInstance = NULL;
+	delete AssemblyContext::Current().m_pObjectCode;
+	AssemblyContext::Current().m_pObjectCode = NULL;
 }
 
 
@@ -78,11 +81,15 @@ void ObjectCode::Destroy()
 /*************************************************************************************************/
 ObjectCode::ObjectCode()
 	:	m_PC( 0 ),
-	 	m_CPU( 0 )
+	 	m_CPU( 0 ),
+		m_numBytesPut( 0 )
 {
 	memset( m_aMemory, 0, sizeof m_aMemory );
 	memset( m_aFlags, 0, sizeof m_aFlags );
-	SymbolTable::Instance().AddSymbol( "CPU", m_CPU );
+	SymbolTable::Instance().AddBuiltInSymbol( "CPU", m_CPU );
+
+	// P% always reads straight from the PC, so emitting code never has to touch the symbol table
+	SymbolTable::Instance().AddBoundSymbol( "P%", &m_PC );
 }
 
 
@@ -110,7 +117,7 @@ ObjectCode::~ObjectCode()
 void ObjectCode::SetCPU( int i )
 {
 	m_CPU = i;
-	SymbolTable::Instance().ChangeSymbol( "CPU", m_CPU );
+	SymbolTable::Instance().ChangeSymbol( SymbolTable::GLOBAL_SCOPE, "CPU", m_CPU );
 }
 
 
@@ -128,7 +135,6 @@ void ObjectCode::InitialisePass()
 
 	SetCPU( 0 );
 	SetPC( 0 );
-	SymbolTable::Instance().ChangeSymbol( "P%", m_PC );
 
 	// Clear flags between passes
 
@@ -172,8 +178,130 @@ void ObjectCode::PutByte( unsigned int byte )
 
 	m_aFlags[ m_PC ] |= USED;
 	m_aMemory[ m_PC++ ] = byte;
+	m_numBytesPut++;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	ObjectCode::PatchByte()
+
+	Overwrites a byte which has already been assembled, without changing its flags; used to fill
+	in forward references in single pass mode
+
+	@param		addr			Address of the byte
+	@param		byte			New value
+*/
+/*************************************************************************************************/
+void ObjectCode::PatchByte( int addr, unsigned int byte )
+{
+	assert( addr >= 0 && addr < 0x10000 );
+	assert( byte < 0x100 );
 
-	SymbolTable::Instance().ChangeSymbol( "P%", m_PC );
+	m_aMemory[ addr ] = byte;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	ObjectCode::PutBytes()
+
+	Puts a block of bytes to memory image, never doing pass consistency checks.  This behaves
+	exactly as if PutByte() had been called for each byte in turn.
+
+	@param		data			The bytes to put
+	@param		length			The number of bytes
+*/
+/*************************************************************************************************/
+void ObjectCode::PutBytes( const unsigned char* data, int length )
+{
+	int good = GetPutLength( length );
+
+	memcpy( m_aMemory + m_PC, data, good );
+	AddFlags( m_PC, good, USED );
+	m_PC += good;
+	m_numBytesPut += good;
+
+	if ( good < length )
+	{
+		ThrowPutError();
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	ObjectCode::ReserveRange()
+
+	Puts a block of zero bytes to memory image, as used by SKIP, SKIPTO and ALIGN.  This behaves
+	exactly as if PutByte( 0 ) had been called for each byte in turn.
+
+	@param		length			The number of bytes
+*/
+/*************************************************************************************************/
+void ObjectCode::ReserveRange( int length )
+{
+	int good = GetPutLength( length );
+
+	memset( m_aMemory + m_PC, 0, good );
+	AddFlags( m_PC, good, USED );
+	m_PC += good;
+	m_numBytesPut += good;
+
+	if ( good < length )
+	{
+		ThrowPutError();
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	ObjectCode::GetPutLength()
+
+	Works out how many bytes can be put at the PC before hitting a guard, existing code or the
+	end of memory
+
+	@param		length			The number of bytes to be put
+
+	@return		int				The number of bytes which can be put
+*/
+/*************************************************************************************************/
+int ObjectCode::GetPutLength( int length ) const
+{
+	assert( m_PC >= 0 && m_PC <= 0x10000 );
+	assert( length >= 0 );
+
+	return FindFlags( m_PC, min( length, 0x10000 - m_PC ), GUARD | USED );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	ObjectCode::ThrowPutError()
+
+	Throws the error which PutByte() would report for a byte at the PC
+*/
+/*************************************************************************************************/
+void ObjectCode::ThrowPutError() const
+{
+	if ( m_PC > 0xFFFF )
+	{
+		throw AsmException_AssembleError_OutOfMemory();
+	}
+
+	if ( m_aFlags[ m_PC ] & GUARD )
+	{
+		throw AsmException_AssembleError_GuardHit();
+	}
+
+	assert( m_aFlags[ m_PC ] & USED );
+	throw AsmException_AssembleError_Overlap();
 }
 
 
@@ -215,8 +343,7 @@ void ObjectCode::Assemble1( unsigned int opcode )
 
 	m_aFlags[ m_PC ] |= ( USED | CHECK );
 	m_aMemory[ m_PC++ ] = opcode;
-
-	SymbolTable::Instance().ChangeSymbol( "P%", m_PC );
+	m_numBytesPut++;
 }
 
 
@@ -263,8 +390,7 @@ void ObjectCode::Assemble2( unsigned int opcode, unsigned int val )
 	m_aMemory[ m_PC++ ] = opcode;
 	m_aFlags[ m_PC ] |= USED;
 	m_aMemory[ m_PC++ ] = val;
-
-	SymbolTable::Instance().ChangeSymbol( "P%", m_PC );
+	m_numBytesPut += 2;
 }
 
 
@@ -315,8 +441,156 @@ void ObjectCode::Assemble3( unsigned int opcode, unsigned int addr )
 	m_aMemory[ m_PC++ ] = addr & 0xFF;
 	m_aFlags[ m_PC ] |= USED;
 	m_aMemory[ m_PC++ ] = ( addr & 0xFF00 ) >> 8;
+	m_numBytesPut += 3;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	ObjectCode::AssembleBytes()
+
+	Assembles a block of bytes to memory image.  This behaves exactly as if Assemble1() had been
+	called for each byte in turn: if any byte cannot be assembled, the ones before it are, the PC
+	is left at the offending address, and the same exception is thrown.
+
+	@param		data			The bytes to assemble
+	@param		length			The number of bytes
+*/
+/*************************************************************************************************/
+void ObjectCode::AssembleBytes( const unsigned char* data, int length )
+{
+	assert( m_PC >= 0 && m_PC <= 0x10000 );
+	assert( length >= 0 );
+
+	// Only the bytes which fit in memory are checked; running off the end is reported once they
+	// have been assembled
+
+	int count = min( length, 0x10000 - m_PC );
+
+	// Find the first byte which would hit a guard or overlap existing code
+
+	int bad = FindFlags( m_PC, count, GUARD | USED );
+
+	// On the second pass, also find the first byte which differs from the first pass.  This is
+	// only worth looking for byte by byte if the block as a whole differs.
+
+	// The offending byte itself is included, as Assemble1() reports an inconsistency first.
+
+	int checkLength = min( bad + 1, count );
+	int inconsistent = count;
+
+	if ( GlobalData::Instance().IsSecondPass() &&
+		 memcmp( m_aMemory + m_PC, data, checkLength ) != 0 )
+	{
+		for ( int i = 0; i < checkLength; i++ )
+		{
+			if ( ( m_aFlags[ m_PC + i ] & CHECK ) &&
+				 !( m_aFlags[ m_PC + i ] & DONT_CHECK ) &&
+				 m_aMemory[ m_PC + i ] != data[ i ] )
+			{
+				inconsistent = i;
+				break;
+			}
+		}
+	}
+
+	int good = min( bad, inconsistent );
+
+	// Assemble everything up to the first problem
+
+	memcpy( m_aMemory + m_PC, data, good );
+	AddFlags( m_PC, good, USED | CHECK );
+	m_PC += good;
+	m_numBytesPut += good;
+
+	if ( good < count )
+	{
+		if ( inconsistent == good )
+		{
+			throw AsmException_AssembleError_InconsistentCode();
+		}
+		else if ( m_aFlags[ m_PC ] & GUARD )
+		{
+			throw AsmException_AssembleError_GuardHit();
+		}
+		else
+		{
+			throw AsmException_AssembleError_Overlap();
+		}
+	}
 
-	SymbolTable::Instance().ChangeSymbol( "P%", m_PC );
+	if ( count < length )
+	{
+		throw AsmException_AssembleError_OutOfMemory();
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	ObjectCode::FindFlags()
+
+	Finds the first byte in a range of memory which has any of the given flags set, testing a
+	machine word's worth of flags at a time
+
+	@param		start			Start address of the range
+	@param		length			Length of the range
+	@param		flags			The flags to look for
+
+	@return		int				Offset from start of the first such byte, or length if none
+*/
+/*************************************************************************************************/
+int ObjectCode::FindFlags( int start, int length, unsigned char flags ) const
+{
+	assert( start >= 0 && length >= 0 && start + length <= 0x10000 );
+
+	const unsigned char* p = m_aFlags + start;
+	const size_t mask = ( ~static_cast< size_t >( 0 ) / 0xFF ) * flags;
+	int i = 0;
+
+	for ( ; i + static_cast< int >( sizeof( size_t ) ) <= length; i += sizeof( size_t ) )
+	{
+		size_t word;
+		memcpy( &word, p + i, sizeof word );
+
+		if ( word & mask )
+		{
+			break;
+		}
+	}
+
+	for ( ; i < length; i++ )
+	{
+		if ( p[ i ] & flags )
+		{
+			return i;
+		}
+	}
+
+	return length;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	ObjectCode::AddFlags()
+
+	Sets the given flags on every byte in a range of memory
+
+	@param		start			Start address of the range
+	@param		length			Length of the range
+	@param		flags			The flags to set
+*/
+/*************************************************************************************************/
+void ObjectCode::AddFlags( int start, int length, unsigned char flags )
+{
+	for ( unsigned char* i = m_aFlags + start; i < m_aFlags + start + length; i++ )
+	{
+		(*i) |= flags;
+	}
 }
 
 
@@ -380,6 +654,25 @@ void ObjectCode::Clear( int start, int end, bool bAll )
 /*************************************************************************************************/
 void ObjectCode::IncBin( const char* filename )
 {
+	const VirtualFiles* pVirtualFiles = GlobalData::Instance().GetVirtualFiles();
+	SharedFiles* pSharedFiles = GlobalData::Instance().GetSharedFiles();
+
+	if ( pVirtualFiles != NULL || pSharedFiles != NULL )
+	{
+		const string* pContents = ( pVirtualFiles != NULL ) ? pVirtualFiles->Find( filename ) : pSharedFiles->Read( filename );
+
+		if ( pContents == NULL )
+		{
+			throw AsmException_AssembleError_FileOpen();
+		}
+
+		if ( !pContents->empty() )
+		{
+			AssembleBytes( reinterpret_cast< const unsigned char* >( pContents->data() ), static_cast< int >( pContents->size() ) );
+		}
+		return;
+	}
+
 	ifstream binfile;
 
 	binfile.open( filename, ios_base::in | ios_base::binary );
@@ -389,12 +682,14 @@ void ObjectCode::IncBin( const char* filename )
 		throw AsmException_AssembleError_FileOpen();
 	}
 
-	char c;
+	// Read the whole file, and then assemble it in one go
+
+	vector< unsigned char > data;
+	char chunk[ 16384 ];
 
-	while ( binfile.get( c ) )
+	while ( binfile.read( chunk, sizeof chunk ) || binfile.gcount() > 0 )
 	{
-		assert( binfile.gcount() == 1 );
-		Assemble1( static_cast< unsigned char >( c ) );
+		data.insert( data.end(), chunk, chunk + binfile.gcount() );
 	}
 
 	if ( !binfile.eof() )
@@ -403,6 +698,11 @@ void ObjectCode::IncBin( const char* filename )
 	}
 
 	binfile.close();
+
+	if ( !data.empty() )
+	{
+		AssembleBytes( &data[ 0 ], static_cast< int >( data.size() ) );
+	}
 }
 
 
@@ -437,10 +737,21 @@ int ObjectCode::GetMapping( int ascii ) const
 
 /*************************************************************************************************/
 /**
-	ObjectCode::CopyBlock()
+	ObjectCode::MoveRange()
+
+	Moves a block of memory, along with its flags, to another address.  The source block is left
+	unused, but keeps its CHECK flags.
+
+	A guard in the destination stops the move at that address, with the bytes which would have
+	been moved before it already moved.  Destination bytes which lie inside the source block are
+	never treated as guarded, as they have been unused by the time they are written.
+
+	@param		start			Start address of the source block
+	@param		end				End address (exclusive) of the source block
+	@param		dest			Destination address
 */
 /*************************************************************************************************/
-void ObjectCode::CopyBlock( int start, int end, int dest )
+void ObjectCode::MoveRange( int start, int end, int dest )
 {
 	int length = end - start;
 
@@ -450,32 +761,64 @@ void ObjectCode::CopyBlock( int start, int end, int dest )
 		throw AsmException_AssembleError_OutOfMemory();
 	}
 
+	if ( start == dest || length <= 0 )
+	{
+		return;
+	}
+
+	// Only the part of the destination outside the source block needs checking for guards.
+	// Moving upwards, it is at the top of the destination and is moved first, from the top down;
+	// moving downwards, it is at the bottom and is moved first, from the bottom up.
+
+	bool bGuardHit = false;
+
 	if ( start < dest )
 	{
-		for ( int i = length - 1; i >= 0; i-- )
+		int checkStart = max( 0, end - dest );
+		int i = checkStart + FindFlags( dest + checkStart, length - checkStart, GUARD );
+
+		while ( i < length )
 		{
-			if ( m_aFlags[ dest + i ] & GUARD )
-			{
-				throw AsmException_AssembleError_GuardHit();
-			}
+			// find the topmost guard
+			bGuardHit = true;
+			checkStart = i + 1;
+			i = checkStart + FindFlags( dest + checkStart, length - checkStart, GUARD );
+		}
 
-			m_aMemory[ dest + i ] = m_aMemory[ start + i ];
-			m_aFlags[ dest + i ] = m_aFlags[ start + i ];
-			m_aFlags[ start + i ] &= ( CHECK | DONT_CHECK );
+		if ( bGuardHit )
+		{
+			start += checkStart;
+			dest += checkStart;
+			length -= checkStart;
 		}
 	}
-	else if ( start > dest )
+	else
 	{
-		for ( int i = 0; i < length; i++ )
-		{
-			if ( m_aFlags[ dest + i ] & GUARD )
-			{
-				throw AsmException_AssembleError_GuardHit();
-			}
+		int checkLength = min( length, start - dest );
+		int i = FindFlags( dest, checkLength, GUARD );
 
-			m_aMemory[ dest + i ] = m_aMemory[ start + i ];
-			m_aFlags[ dest + i ] = m_aFlags[ start + i ];
-			m_aFlags[ start + i ] &= ( CHECK | DONT_CHECK );
+		if ( i < checkLength )
+		{
+			bGuardHit = true;
+			length = i;
 		}
 	}
+
+	// Now move the data, and then unuse the part of the source block which wasn't overwritten
+
+	memmove( m_aMemory + dest, m_aMemory + start, length );
+	memmove( m_aFlags + dest, m_aFlags + start, length );
+
+	int unusedStart = ( start < dest ) ? start : max( start, dest + length );
+	int unusedEnd = ( start < dest ) ? min( start + length, dest ) : start + length;
+
+	for ( unsigned char* i = m_aFlags + unusedStart; i < m_aFlags + unusedEnd; i++ )
+	{
+		(*i) &= ( CHECK | DONT_CHECK );
+	}
+
+	if ( bGuardHit )
+	{
+		throw AsmException_AssembleError_GuardHit();
+	}
 }
@@ -25,6 +25,7 @@
 
 #include <cassert>
 #include <cstdlib>
+#include "assemblycontext.h"
 
 
 class ObjectCode
@@ -33,7 +34,7 @@ public:
 
 	static void Create();
 	static void Destroy();
-	static inline ObjectCode& Instance() { assert( m_gInstance != NULL ); return *m_gInstance; }
+	static inline ObjectCode& Instance() { assert( AssemblyContext::Current().m_pObjectCode != NULL ); return *AssemblyContext::Current().m_pObjectCode; }
 
 	inline void SetPC( int i )		{ m_PC = i; }
 	inline int GetPC() const		{ return m_PC; }
@@ -43,12 +44,20 @@ public:
 
 	inline const unsigned char* GetAddr( int i ) const { return m_aMemory + i; }
 
+	// Running total of bytes assembled or reserved, for statistics
+
+	inline unsigned long GetNumBytesPut() const	{ return m_numBytesPut; }
+
 	void InitialisePass();
 
 	void PutByte( unsigned int byte );
+	void PutBytes( const unsigned char* data, int length );
+	void ReserveRange( int length );
+	void PatchByte( int addr, unsigned int byte );
 	void Assemble1( unsigned int opcode );
 	void Assemble2( unsigned int opcode, unsigned int val );
 	void Assemble3( unsigned int opcode, unsigned int addr );
+	void AssembleBytes( const unsigned char* data, int length );
 	void IncBin( const char* filename );
 
 	void SetGuard( int i );
@@ -57,7 +66,7 @@ public:
 	void SetMapping( int ascii, int mapped );
 	int GetMapping( int ascii ) const;
 
-	void CopyBlock( int start, int end, int dest );
+	void MoveRange( int start, int end, int dest );
 
 private:
 
@@ -73,14 +82,18 @@ private:
 	ObjectCode();
 	~ObjectCode();
 
+	int FindFlags( int start, int length, unsigned char flags ) const;
+	void AddFlags( int start, int length, unsigned char flags );
+	int GetPutLength( int length ) const;
+	void ThrowPutError() const;
+
 	unsigned char				m_aMemory[ 0x10000 ];
 	unsigned char				m_aFlags[ 0x10000 ];
 	int							m_PC;
 	int							m_CPU;
+	unsigned long				m_numBytesPut;
 
 	unsigned char				m_aMapChar[ 96 ];
-
-	static ObjectCode*			m_gInstance;
 };
 
 
@@ -0,0 +1,475 @@
+/*************************************************************************************************/
+/**
+	profiler.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "profiler.h"
+
+
+using namespace std;
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::Create()
+
+	Creates the Profiler singleton
+
+	@param		bFoldedStacks	Whether to keep the time for each folded stack, as well as each line
+*/
+/*************************************************************************************************/
+void Profiler::Create( bool bFoldedStacks )
+{
+	assert( AssemblyContext::Current().m_pProfiler == NULL );
+
+	AssemblyContext::Current().m_pProfiler = new Profiler( bFoldedStacks );
+	Instrumentation::Add( AssemblyContext::Current().m_pProfiler );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::Destroy()
+
+	Destroys the Profiler singleton
+*/
+/*************************************************************************************************/
+void Profiler::Destroy()
+{
+	assert( AssemblyContext::Current().m_pProfiler != NULL );
+
+	Instrumentation::Remove( AssemblyContext::Current().m_pProfiler );
+	delete AssemblyContext::Current().m_pProfiler;
+	AssemblyContext::Current().m_pProfiler = NULL;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::Profiler()
+
+	Profiler constructor
+*/
+/*************************************************************************************************/
+Profiler::Profiler( bool bFoldedStacks )
+	:	m_bFoldedStacks( bFoldedStacks ),
+		m_last( Clock::now() ),
+		m_pLine( NULL ),
+		m_pCurrentMacro( NULL ),
+		m_pFoldedTime( NULL )
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::~Profiler()
+
+	Profiler destructor
+*/
+/*************************************************************************************************/
+Profiler::~Profiler()
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::BeginPass()
+
+	Starts profiling a pass; the pass is the outermost frame of the folded stacks
+
+	@param		name			Name of the pass
+*/
+/*************************************************************************************************/
+void Profiler::BeginPass( const string& name )
+{
+	m_frames.clear();
+	m_activeMacros.clear();
+	m_stack = name;
+	m_leaf.clear();
+	m_pLine = NULL;
+	m_pCurrentMacro = NULL;
+	m_pFoldedTime = NULL;
+	m_last = Clock::now();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::EndPass()
+
+	Finishes profiling a pass
+*/
+/*************************************************************************************************/
+void Profiler::EndPass()
+{
+	Charge();
+
+	m_pLine = NULL;
+	m_pCurrentMacro = NULL;
+	m_pFoldedTime = NULL;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::Charge()
+
+	Charges the time since the last event to the current line, macro and folded stack
+*/
+/*************************************************************************************************/
+void Profiler::Charge()
+{
+	Clock::time_point now = Clock::now();
+	double seconds = chrono::duration< double >( now - m_last ).count();
+
+	m_last = now;
+
+	if ( m_pLine != NULL )
+	{
+		m_pLine->m_seconds += seconds;
+	}
+
+	if ( m_pCurrentMacro != NULL )
+	{
+		m_pCurrentMacro->m_selfSeconds += seconds;
+	}
+
+	if ( m_pFoldedTime != NULL )
+	{
+		*m_pFoldedTime += seconds;
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::UpdateFoldedStack()
+
+	Finds where to keep the time for the current stack and line
+*/
+/*************************************************************************************************/
+void Profiler::UpdateFoldedStack()
+{
+	if ( m_bFoldedStacks )
+	{
+		m_pFoldedTime = &m_foldedStacks[ m_leaf.empty() ? m_stack : m_stack + ";" + m_leaf ];
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::BeginLine()
+
+	Starts charging time to a new line
+
+	@param		filename		File containing the line
+	@param		lineNumber		Line number
+*/
+/*************************************************************************************************/
+void Profiler::BeginLine( const string& filename, int lineNumber )
+{
+	Charge();
+
+	m_pLine = &m_lines[ filename ][ lineNumber ];
+	m_pLine->m_count++;
+
+	if ( m_bFoldedStacks )
+	{
+		char buffer[ 16 ];
+		sprintf( buffer, ":%d", lineNumber );
+		m_leaf = filename + buffer;
+		UpdateFoldedStack();
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::EnterSource()
+
+	Starts processing a source file or macro instance.  Until its first line starts, time is still
+	charged to the line which included or called it.
+
+	@param		name			Filename, or macro name
+	@param		bIsMacro		Whether it is a macro instance
+*/
+/*************************************************************************************************/
+void Profiler::EnterSource( const string& name, bool bIsMacro )
+{
+	Charge();
+
+	Frame frame;
+	frame.m_bIsFor = false;
+	frame.m_stackLength = m_stack.length();
+	frame.m_start = m_last;
+	frame.m_pMacro = NULL;
+	frame.m_pActive = NULL;
+	frame.m_bOutermost = false;
+	frame.m_pLine = m_pLine;
+	frame.m_leaf = m_leaf;
+	frame.m_pCurrentMacro = m_pCurrentMacro;
+
+	m_stack += ";";
+
+	if ( bIsMacro )
+	{
+		frame.m_pMacro = &m_macros[ name ];
+		frame.m_pMacro->m_calls++;
+		frame.m_pActive = &m_activeMacros[ name ];
+		frame.m_bOutermost = ( ( *frame.m_pActive )++ == 0 );
+		m_pCurrentMacro = frame.m_pMacro;
+		m_stack += "MACRO ";
+	}
+
+	m_stack += name;
+	m_frames.push_back( frame );
+
+	m_leaf.clear();
+	UpdateFoldedStack();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::ExitSource()
+
+	Finishes processing the innermost source file or macro instance, along with any FOR loops
+	still open inside it
+*/
+/*************************************************************************************************/
+void Profiler::ExitSource( const string&, bool, unsigned long )
+{
+	Charge();
+
+	while ( !m_frames.empty() )
+	{
+		Frame frame = m_frames.back();
+		m_frames.pop_back();
+		m_stack.resize( frame.m_stackLength );
+
+		if ( frame.m_bIsFor )
+		{
+			continue;
+		}
+
+		if ( frame.m_pMacro != NULL )
+		{
+			if ( frame.m_bOutermost )
+			{
+				frame.m_pMacro->m_seconds += chrono::duration< double >( m_last - frame.m_start ).count();
+			}
+
+			( *frame.m_pActive )--;
+		}
+
+		m_pLine = frame.m_pLine;
+		m_leaf = frame.m_leaf;
+		m_pCurrentMacro = frame.m_pCurrentMacro;
+		break;
+	}
+
+	UpdateFoldedStack();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::BeginFor()
+
+	Starts a FOR loop, which appears as a frame of its own in the folded stacks
+
+	@param		filename		File containing the FOR
+	@param		lineNumber		Line number of the FOR
+*/
+/*************************************************************************************************/
+void Profiler::BeginFor( const string& filename, int lineNumber )
+{
+	Charge();
+
+	Frame frame;
+	frame.m_bIsFor = true;
+	frame.m_stackLength = m_stack.length();
+	frame.m_start = m_last;
+	frame.m_pMacro = NULL;
+	frame.m_pActive = NULL;
+	frame.m_bOutermost = false;
+	frame.m_pLine = NULL;
+	frame.m_pCurrentMacro = NULL;
+	m_frames.push_back( frame );
+
+	char buffer[ 16 ];
+	sprintf( buffer, ":%d", lineNumber );
+	m_stack += ";FOR " + filename + buffer;
+
+	UpdateFoldedStack();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::EndFor()
+
+	Finishes the innermost FOR loop
+*/
+/*************************************************************************************************/
+void Profiler::EndFor( int )
+{
+	Charge();
+
+	if ( !m_frames.empty() && m_frames.back().m_bIsFor )
+	{
+		m_stack.resize( m_frames.back().m_stackLength );
+		m_frames.pop_back();
+	}
+
+	UpdateFoldedStack();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SortBySeconds()
+
+	Sorts named times with the longest first
+*/
+/*************************************************************************************************/
+template< class T >
+static bool SortBySeconds( const pair< string, T >& a, const pair< string, T >& b )
+{
+	return a.second.m_seconds > b.second.m_seconds;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::Report()
+
+	Writes out the lines and macros which took the most time
+
+	@param		stream			Where to write them
+	@param		numHotspots		How many lines and macros to list
+*/
+/*************************************************************************************************/
+void Profiler::Report( ostream& stream, int numHotspots ) const
+{
+	char buffer[ 256 ];
+	double totalSeconds = 0.0;
+
+	vector< pair< string, Hotspot > > lines;
+
+	for ( map< string, map< int, Hotspot > >::const_iterator file = m_lines.begin(); file != m_lines.end(); ++file )
+	{
+		for ( map< int, Hotspot >::const_iterator line = file->second.begin(); line != file->second.end(); ++line )
+		{
+			sprintf( buffer, ":%d", line->first );
+			lines.push_back( make_pair( file->first + buffer, line->second ) );
+			totalSeconds += line->second.m_seconds;
+		}
+	}
+
+	stable_sort( lines.begin(), lines.end(), SortBySeconds< Hotspot > );
+
+	if ( lines.size() > static_cast< size_t >( numHotspots ) )
+	{
+		lines.resize( numHotspots );
+	}
+
+	stream << "Hotspots, all passes:" << endl;
+	sprintf( buffer, "%12s %7s %12s  %s", "seconds", "%", "count", "line" );
+	stream << buffer << endl;
+
+	for ( vector< pair< string, Hotspot > >::const_iterator it = lines.begin(); it != lines.end(); ++it )
+	{
+		sprintf( buffer, "%12.6f %6.2f%% %12lu  ", it->second.m_seconds,
+				 ( totalSeconds > 0.0 ) ? 100.0 * it->second.m_seconds / totalSeconds : 0.0, it->second.m_count );
+		stream << buffer << it->first << endl;
+	}
+
+	if ( m_macros.empty() )
+	{
+		return;
+	}
+
+	vector< pair< string, MacroTime > > macros( m_macros.begin(), m_macros.end() );
+	stable_sort( macros.begin(), macros.end(), SortBySeconds< MacroTime > );
+
+	if ( macros.size() > static_cast< size_t >( numHotspots ) )
+	{
+		macros.resize( numHotspots );
+	}
+
+	stream << endl << "Macros, all passes:" << endl;
+	sprintf( buffer, "%12s %12s %12s  %s", "seconds", "self", "calls", "macro" );
+	stream << buffer << endl;
+
+	for ( vector< pair< string, MacroTime > >::const_iterator it = macros.begin(); it != macros.end(); ++it )
+	{
+		sprintf( buffer, "%12.6f %12.6f %12lu  ", it->second.m_seconds, it->second.m_selfSeconds, it->second.m_calls );
+		stream << buffer << it->first << endl;
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Profiler::WriteFoldedStacks()
+
+	Writes the time spent in each stack of passes, files, macros, FOR loops and lines, in the
+	folded format read by flame graph tools: one stack per line, with the frames separated by ';'
+	and followed by the time in microseconds
+
+	@param		stream			Where to write them
+*/
+/*************************************************************************************************/
+void Profiler::WriteFoldedStacks( ostream& stream ) const
+{
+	for ( map< string, double >::const_iterator it = m_foldedStacks.begin(); it != m_foldedStacks.end(); ++it )
+	{
+		long microseconds = lround( it->second * 1000000.0 );
+
+		if ( microseconds > 0 )
+		{
+			stream << it->first << " " << microseconds << endl;
+		}
+	}
+}
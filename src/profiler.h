@@ -0,0 +1,124 @@
+/*************************************************************************************************/
+/**
+	profiler.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "instrumentation.h"
+
+
+// Attributes assembly time to source lines and macros, as reported by --profile.  The time between
+// one event and the next (a line starting, a source file, macro or FOR loop being entered or left)
+// is charged to the line being processed, so nested files and macros are not counted twice.
+
+class Profiler : public Instrument
+{
+public:
+
+	static void Create( bool bFoldedStacks );
+	static void Destroy();
+	static inline Profiler* Get() { return AssemblyContext::Current().m_pProfiler; }
+
+	virtual void BeginPass( const std::string& name );
+	virtual void EndPass();
+
+	virtual void EnterSource( const std::string& name, bool bIsMacro );
+	virtual void ExitSource( const std::string& name, bool bIsMacro, unsigned long numLines );
+
+	virtual void BeginLine( const std::string& filename, int lineNumber );
+
+	virtual void BeginFor( const std::string& filename, int lineNumber );
+	virtual void EndFor( int numIterations );
+
+	void Report( std::ostream& stream, int numHotspots ) const;
+	void WriteFoldedStacks( std::ostream& stream ) const;
+
+
+private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Hotspot
+	{
+		Hotspot() : m_count( 0 ), m_seconds( 0.0 ) {}
+
+		unsigned long		m_count;
+		double				m_seconds;
+	};
+
+	struct MacroTime
+	{
+		MacroTime() : m_calls( 0 ), m_seconds( 0.0 ), m_selfSeconds( 0.0 ) {}
+
+		unsigned long		m_calls;
+		double				m_seconds;			// including macros it calls, but not counting recursion twice
+		double				m_selfSeconds;		// in its own lines only
+	};
+
+	struct Frame
+	{
+		bool				m_bIsFor;
+		size_t				m_stackLength;		// length of m_stack before this frame was added
+		Clock::time_point	m_start;
+		MacroTime*			m_pMacro;			// if this frame is a macro instance
+		int*				m_pActive;			// number of instances of the macro being processed
+		bool				m_bOutermost;		// if it isn't inside another instance of the same macro
+
+		// What was being processed when the frame was entered, restored when it is left
+
+		Hotspot*			m_pLine;
+		std::string			m_leaf;
+		MacroTime*			m_pCurrentMacro;
+	};
+
+	explicit Profiler( bool bFoldedStacks );
+	virtual ~Profiler();
+
+	void Charge();
+	void UpdateFoldedStack();
+
+	bool									m_bFoldedStacks;
+	Clock::time_point						m_last;			// when time was last charged
+
+	std::vector< Frame >					m_frames;
+	std::string								m_stack;		// folded names of the frames, separated by ';'
+	std::string								m_leaf;			// folded name of the current line
+	Hotspot*								m_pLine;		// the current line
+	MacroTime*								m_pCurrentMacro;	// the macro the current line belongs to
+	double*									m_pFoldedTime;	// time for the current stack and line
+
+	std::map< std::string, std::map< int, Hotspot > >	m_lines;
+	std::map< std::string, MacroTime >		m_macros;
+	std::map< std::string, int >			m_activeMacros;	// instances of each macro being processed
+	std::map< std::string, double >			m_foldedStacks;
+};
+
+
+
+#endif // PROFILER_H_
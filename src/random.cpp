@@ -25,18 +25,20 @@
 /*************************************************************************************************/
 
 #include "random.h"
+#include "assemblycontext.h"
 
-static unsigned long state = 19670512;
+// The generator state belongs to the current AssemblyContext
 
-static unsigned long modulus = BEEBASM_RAND_MODULUS;
+static const unsigned long modulus = BEEBASM_RAND_MODULUS;
 
 void beebasm_srand(unsigned long seed)
 {
-        state = seed % modulus;
+        unsigned long state = seed % modulus;
         if ( state == 0 )
         {
                 state = 1;
         }
+        AssemblyContext::Current().SetRandomState( state );
 
         // Generate and discard a few random numbers to avoid small changes to
         // the seed typically not affecting the first few random numbers
@@ -49,7 +51,8 @@ void beebasm_srand(unsigned long seed)
 
 unsigned long beebasm_rand()
 {
-        state = ( BEEBASM_RAND_MULTIPLIER * state ) % modulus;
+        unsigned long state = ( BEEBASM_RAND_MULTIPLIER * AssemblyContext::Current().GetRandomState() ) % modulus;
+        AssemblyContext::Current().SetRandomState( state );
         // It's always true that 1 <= state <= (modulus - 1), so we return state - 1 to make
         // 0 a possible value. BEEBASM_RAND_MAX is modulus - 2, so we have 0 <= return value <=
         // BEEBASM_RAND_MAX as required for compatibility with the interface of rand().
@@ -0,0 +1,189 @@
+/*************************************************************************************************/
+/**
+	sha256.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <cstdint>
+#include <cstdio>
+#include "sha256.h"
+
+using namespace std;
+
+
+namespace Sha256
+{
+
+
+static const uint32_t K[ 64 ] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+
+
+static inline uint32_t RotateRight( uint32_t x, int n )
+{
+	return ( x >> n ) | ( x << ( 32 - n ) );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	ProcessBlock()
+
+	Updates the hash state with one 64 byte block of the message
+
+	@param		state			The eight words of hash state
+	@param		block			The block
+*/
+/*************************************************************************************************/
+static void ProcessBlock( uint32_t state[ 8 ], const unsigned char block[ 64 ] )
+{
+	uint32_t w[ 64 ];
+
+	for ( int i = 0; i < 16; i++ )
+	{
+		w[ i ] = ( static_cast< uint32_t >( block[ i * 4 ] ) << 24 ) |
+				 ( static_cast< uint32_t >( block[ i * 4 + 1 ] ) << 16 ) |
+				 ( static_cast< uint32_t >( block[ i * 4 + 2 ] ) << 8 ) |
+				 static_cast< uint32_t >( block[ i * 4 + 3 ] );
+	}
+
+	for ( int i = 16; i < 64; i++ )
+	{
+		uint32_t s0 = RotateRight( w[ i - 15 ], 7 ) ^ RotateRight( w[ i - 15 ], 18 ) ^ ( w[ i - 15 ] >> 3 );
+		uint32_t s1 = RotateRight( w[ i - 2 ], 17 ) ^ RotateRight( w[ i - 2 ], 19 ) ^ ( w[ i - 2 ] >> 10 );
+		w[ i ] = w[ i - 16 ] + s0 + w[ i - 7 ] + s1;
+	}
+
+	uint32_t a = state[ 0 ];
+	uint32_t b = state[ 1 ];
+	uint32_t c = state[ 2 ];
+	uint32_t d = state[ 3 ];
+	uint32_t e = state[ 4 ];
+	uint32_t f = state[ 5 ];
+	uint32_t g = state[ 6 ];
+	uint32_t h = state[ 7 ];
+
+	for ( int i = 0; i < 64; i++ )
+	{
+		uint32_t s1 = RotateRight( e, 6 ) ^ RotateRight( e, 11 ) ^ RotateRight( e, 25 );
+		uint32_t ch = ( e & f ) ^ ( ~e & g );
+		uint32_t t1 = h + s1 + ch + K[ i ] + w[ i ];
+		uint32_t s0 = RotateRight( a, 2 ) ^ RotateRight( a, 13 ) ^ RotateRight( a, 22 );
+		uint32_t maj = ( a & b ) ^ ( a & c ) ^ ( b & c );
+		uint32_t t2 = s0 + maj;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[ 0 ] += a;
+	state[ 1 ] += b;
+	state[ 2 ] += c;
+	state[ 3 ] += d;
+	state[ 4 ] += e;
+	state[ 5 ] += f;
+	state[ 6 ] += g;
+	state[ 7 ] += h;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	HashToHex()
+
+	Calculates the SHA-256 hash of a block of text or binary data
+
+	@param		data			Data to hash
+
+	@return		string			The hash as 64 hex digits
+*/
+/*************************************************************************************************/
+string HashToHex( const string& data )
+{
+	uint32_t state[ 8 ] =
+	{
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	const unsigned char* pData = reinterpret_cast< const unsigned char* >( data.data() );
+	size_t length = data.length();
+	size_t offset = 0;
+
+	for ( ; offset + 64 <= length; offset += 64 )
+	{
+		ProcessBlock( state, pData + offset );
+	}
+
+	// Pad the remainder with a 1 bit, then zeroes, then the length in bits, over one or two blocks
+
+	unsigned char tail[ 128 ] = { 0 };
+	size_t tailLength = length - offset;
+
+	for ( size_t i = 0; i < tailLength; i++ )
+	{
+		tail[ i ] = pData[ offset + i ];
+	}
+
+	tail[ tailLength ] = 0x80;
+
+	size_t paddedLength = ( tailLength < 56 ) ? 64 : 128;
+	unsigned long long bitLength = static_cast< unsigned long long >( length ) * 8;
+
+	for ( int i = 0; i < 8; i++ )
+	{
+		tail[ paddedLength - 1 - i ] = static_cast< unsigned char >( bitLength >> ( i * 8 ) );
+	}
+
+	ProcessBlock( state, tail );
+
+	if ( paddedLength == 128 )
+	{
+		ProcessBlock( state, tail + 64 );
+	}
+
+	char hex[ 65 ];
+
+	for ( int i = 0; i < 8; i++ )
+	{
+		sprintf( hex + i * 8, "%08x", static_cast< unsigned int >( state[ i ] ) );
+	}
+
+	return hex;
+}
+
+
+} // namespace Sha256
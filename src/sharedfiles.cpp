@@ -0,0 +1,108 @@
+/*************************************************************************************************/
+/**
+	sharedfiles.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <fstream>
+
+#include "sharedfiles.h"
+
+
+using namespace std;
+
+
+
+/*************************************************************************************************/
+/**
+	SharedFiles::SharedFiles()
+
+	SharedFiles constructor
+*/
+/*************************************************************************************************/
+SharedFiles::SharedFiles()
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SharedFiles::~SharedFiles()
+
+	SharedFiles destructor
+*/
+/*************************************************************************************************/
+SharedFiles::~SharedFiles()
+{
+	for ( map< string, string* >::iterator it = m_files.begin(); it != m_files.end(); ++it )
+	{
+		delete it->second;
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SharedFiles::Read()
+
+	Gets the contents of a file, reading it if no thread has yet done so
+
+	@param		filename		Filename, as given in the source
+
+	@return		const string*	Contents of the file, or NULL if it couldn't be read
+*/
+/*************************************************************************************************/
+const string* SharedFiles::Read( const string& filename )
+{
+	lock_guard< mutex > lock( m_mutex );
+
+	map< string, string* >::iterator it = m_files.find( filename );
+
+	if ( it != m_files.end() )
+	{
+		return it->second;
+	}
+
+	ifstream file( filename.c_str(), ios_base::binary );
+	string* pContents = NULL;
+
+	if ( file )
+	{
+		pContents = new string;
+
+		char chunk[ 16384 ];
+
+		while ( file.read( chunk, sizeof chunk ) || file.gcount() > 0 )
+		{
+			pContents->append( chunk, static_cast< size_t >( file.gcount() ) );
+		}
+
+		if ( !file.eof() )
+		{
+			delete pContents;
+			pContents = NULL;
+		}
+	}
+
+	m_files[ filename ] = pContents;
+
+	return pContents;
+}
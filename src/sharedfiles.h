@@ -0,0 +1,52 @@
+/*************************************************************************************************/
+/**
+	sharedfiles.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef SHAREDFILES_H_
+#define SHAREDFILES_H_
+
+#include <map>
+#include <mutex>
+#include <string>
+
+
+// Files read once and shared between assemblies running on several threads.  A file's contents
+// never change once it has been read, so they can be used without holding the lock.
+
+class SharedFiles
+{
+public:
+
+	SharedFiles();
+	~SharedFiles();
+
+	const std::string* Read( const std::string& filename );
+
+
+private:
+
+	std::mutex								m_mutex;
+	std::map< std::string, std::string* >	m_files;		// NULL if the file couldn't be read
+};
+
+
+
+#endif // SHAREDFILES_H_
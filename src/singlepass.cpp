@@ -0,0 +1,406 @@
+/*************************************************************************************************/
+/**
+	singlepass.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include "singlepass.h"
+#include "asmexception.h"
+#include "linecache.h"
+#include "lineparser.h"
+#include "objectcode.h"
+#include "symboltable.h"
+
+
+using namespace std;
+
+
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::Create()
+
+	Creates the SinglePass singleton
+*/
+/*************************************************************************************************/
+void SinglePass::Create()
+{
+	assert( AssemblyContext::Current().m_pSinglePass == NULL );
+
+	AssemblyContext::Current().m_pSinglePass = new SinglePass;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::Destroy()
+
+	Destroys the SinglePass singleton
+*/
+/*************************************************************************************************/
+void SinglePass::Destroy()
+{
+	assert( AssemblyContext::Current().m_pSinglePass != NULL );
+
+	delete AssemblyContext::Current().m_pSinglePass;
+	AssemblyContext::Current().m_pSinglePass = NULL;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::SinglePass()
+
+	SinglePass constructor
+*/
+/*************************************************************************************************/
+SinglePass::SinglePass()
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::~SinglePass()
+
+	SinglePass destructor
+*/
+/*************************************************************************************************/
+SinglePass::~SinglePass()
+{
+	for ( vector< Fixup >::iterator it = m_fixups.begin(); it != m_fixups.end(); ++it )
+	{
+		delete it->m_expression;
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::AddFixup()
+
+	Records an operand which has been assembled with a placeholder value
+
+	@param		type			What sort of operand it is, which determines how it is checked
+	@param		address			Address of the instruction or data
+	@param		scope			Scope in which the expression was evaluated
+	@param		sourceLine		The line containing the expression
+	@param		expression		The expression, with everything already known folded in; the
+								SinglePass object takes ownership of it
+*/
+/*************************************************************************************************/
+void SinglePass::AddFixup( FIXUP_TYPE type, int address, int scope, SourceLine* sourceLine, CompiledExpression* expression )
+{
+	Fixup fixup;
+	fixup.m_type		= type;
+	fixup.m_address		= address;
+	fixup.m_scope		= scope;
+	fixup.m_sourceLine	= sourceLine;
+	fixup.m_expression	= expression;
+
+	// the scope mustn't be freed and reused while the fixup refers to it
+
+	SymbolTable::Instance().HoldScope( scope );
+	m_fixups.push_back( fixup );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::ResolveFixups()
+
+	Patches all the fixups whose operands lie in a range of memory, throwing
+	AsmException_SinglePassFailed if any of them can't be resolved yet, or resolve to a value which
+	the second pass would have assembled differently
+
+	@param		start			Start address of the range
+	@param		end				End address of the range (exclusive)
+*/
+/*************************************************************************************************/
+void SinglePass::ResolveFixups( int start, int end )
+{
+	vector< Fixup >::iterator kept = m_fixups.begin();
+
+	for ( vector< Fixup >::iterator it = m_fixups.begin(); it != m_fixups.end(); ++it )
+	{
+		int operand = it->m_address + GetOperandOffset( it->m_type );
+
+		if ( operand + GetOperandSize( it->m_type ) <= start || operand >= end )
+		{
+			*kept++ = *it;
+			continue;
+		}
+
+		try
+		{
+			ResolveFixup( *it );
+		}
+		catch ( ... )
+		{
+			// The slots between the kept fixups and this one have either been resolved (and their
+			// expressions deleted) or copied down, so drop them to leave each remaining fixup
+			// owning its expression exactly once
+
+			m_fixups.erase( kept, it );
+			throw;
+		}
+
+		delete it->m_expression;
+	}
+
+	m_fixups.erase( kept, m_fixups.end() );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::ResolveFixup()
+
+	Evaluates a fixup's expression, checks it against the rules the second pass would have applied,
+	and writes the operand into memory
+
+	@param		fixup			The fixup to resolve
+*/
+/*************************************************************************************************/
+void SinglePass::ResolveFixup( const Fixup& fixup ) const
+{
+	const CompiledExpression& expression = *fixup.m_expression;
+
+	// A symbol which was undefined when the fixup was made could since have been defined as a FOR
+	// variable, which the second pass wouldn't have seen at that point
+
+	for ( vector< string >::const_iterator it = expression.m_symbols.begin(); it != expression.m_symbols.end(); ++it )
+	{
+		if ( m_forVariables.count( *it ) != 0 )
+		{
+			throw AsmException_SinglePassFailed();
+		}
+	}
+
+	CompiledExpression* folded = LineParser::FoldExpression( expression, fixup.m_scope );
+
+	double result;
+
+	try
+	{
+		if ( folded == NULL || !folded->m_symbols.empty() )
+		{
+			throw AsmException_SinglePassFailed();
+		}
+
+		result = LineParser::EvaluateFoldedExpression( *fixup.m_sourceLine, *folded );
+	}
+	catch ( ... )
+	{
+		delete folded;
+		throw;
+	}
+
+	delete folded;
+
+	// Apply the same checks and conversions as the instruction or directive which made the fixup
+
+	int value = static_cast< int >( result );
+	unsigned int operand;
+
+	switch ( fixup.m_type )
+	{
+		case BYTE:
+
+			if ( value > 0xFF )
+			{
+				throw AsmException_SinglePassFailed();
+			}
+			operand = value & 0xFF;
+			break;
+
+		case WORD:
+
+			if ( value > 0xFFFF )
+			{
+				throw AsmException_SinglePassFailed();
+			}
+			operand = value & 0xFFFF;
+			break;
+
+		case DWORD:
+
+			operand = static_cast< unsigned int >( result );
+			break;
+
+		case IMMEDIATE:
+		case ZERO_PAGE:
+
+			if ( value < 0 || value > 0xFF )
+			{
+				throw AsmException_SinglePassFailed();
+			}
+			operand = value;
+			break;
+
+		case ABSOLUTE:
+		case ABSOLUTE_NOT_ZERO_PAGE:
+		case INDIRECT:
+
+			if ( value < 0 || value > 0xFFFF ||
+				 ( fixup.m_type == ABSOLUTE_NOT_ZERO_PAGE && value < 0x100 ) ||
+				 ( fixup.m_type == INDIRECT && ( value & 0xFF ) == 0xFF ) )
+			{
+				throw AsmException_SinglePassFailed();
+			}
+			operand = value;
+			break;
+
+		case RELATIVE:
+		{
+			int branchAmount = value - ( fixup.m_address + 2 );
+
+			if ( branchAmount < -128 || branchAmount > 127 )
+			{
+				throw AsmException_SinglePassFailed();
+			}
+			operand = branchAmount & 0xFF;
+			break;
+		}
+
+		default:
+
+			assert( false );
+			operand = 0;
+			break;
+	}
+
+	int address = fixup.m_address + GetOperandOffset( fixup.m_type );
+
+	for ( int i = 0; i < GetOperandSize( fixup.m_type ); i++ )
+	{
+		ObjectCode::Instance().PatchByte( address + i, ( operand >> ( i * 8 ) ) & 0xFF );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::GetOperandOffset()
+
+	Returns where a fixup's operand lies relative to its address
+*/
+/*************************************************************************************************/
+int SinglePass::GetOperandOffset( FIXUP_TYPE type )
+{
+	return ( type == BYTE || type == WORD || type == DWORD ) ? 0 : 1;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::GetOperandSize()
+
+	Returns the number of bytes in a fixup's operand
+*/
+/*************************************************************************************************/
+int SinglePass::GetOperandSize( FIXUP_TYPE type )
+{
+	switch ( type )
+	{
+		case WORD:
+		case ABSOLUTE:
+		case ABSOLUTE_NOT_ZERO_PAGE:
+		case INDIRECT:
+			return 2;
+
+		case DWORD:
+			return 4;
+
+		default:
+			return 1;
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::CheckDefinition()
+
+	Called before a symbol is defined in single pass mode.  The second pass sees every symbol from
+	the start, so if the new symbol hides one in an outer scope which has already been referred to
+	from an inner scope, or has the name of an earlier FOR variable, expressions evaluated before
+	this point could have had different values.
+
+	@param		scope			Scope the symbol is being defined in
+	@param		symbolName		Name of the symbol
+*/
+/*************************************************************************************************/
+void SinglePass::CheckDefinition( int scope, const string& symbolName ) const
+{
+	if ( HidesOuterReference( scope, symbolName ) || m_forVariables.count( symbolName ) != 0 )
+	{
+		throw AsmException_SinglePassFailed();
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::AddForVariable()
+
+	Called before a FOR variable is defined in single pass mode
+
+	@param		scope			Scope the variable is being defined in
+	@param		symbolName		Name of the variable
+*/
+/*************************************************************************************************/
+void SinglePass::AddForVariable( int scope, const string& symbolName )
+{
+	if ( HidesOuterReference( scope, symbolName ) )
+	{
+		throw AsmException_SinglePassFailed();
+	}
+
+	m_forVariables.insert( symbolName );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SinglePass::HidesOuterReference()
+
+	Returns whether defining a symbol would hide one in an outer scope which might already have
+	been referred to from this scope
+*/
+/*************************************************************************************************/
+bool SinglePass::HidesOuterReference( int scope, const string& symbolName ) const
+{
+	return ( scope != SymbolTable::GLOBAL_SCOPE &&
+			 m_outerReferences.count( symbolName ) != 0 &&
+			 SymbolTable::Instance().ResolveSymbol( SymbolTable::Instance().GetParentScope( scope ), symbolName ) != -1 );
+}
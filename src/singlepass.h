@@ -0,0 +1,98 @@
+/*************************************************************************************************/
+/**
+	singlepass.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef SINGLEPASS_H_
+#define SINGLEPASS_H_
+
+#include <cassert>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+#include "assemblycontext.h"
+
+class SourceLine;
+struct CompiledExpression;
+
+
+// In single pass mode, the source is assembled once, with operands which refer to symbols that
+// are not yet defined assembled as placeholders and recorded as fixups.  The fixups are patched
+// when the memory they occupy is saved, and at the end of the pass.  Anything which can't be
+// handled this way throws AsmException_SinglePassFailed, and the source is assembled again in two
+// passes as usual.
+
+class SinglePass
+{
+public:
+
+	enum FIXUP_TYPE
+	{
+		BYTE,					// EQUB
+		WORD,					// EQUW
+		DWORD,					// EQUD
+		IMMEDIATE,				// #imm
+		ZERO_PAGE,				// (zp), (zp,X) and (zp),Y
+		ABSOLUTE,				// abs, abs,X, abs,Y and (abs,X)
+		ABSOLUTE_NOT_ZERO_PAGE,	// as ABSOLUTE, where a zero page version of the instruction exists
+		INDIRECT,				// (abs), which mustn't hit the 6502 page boundary bug
+		RELATIVE				// branches
+	};
+
+	static void Create();
+	static void Destroy();
+	static inline SinglePass& Instance() { assert( AssemblyContext::Current().m_pSinglePass != NULL ); return *AssemblyContext::Current().m_pSinglePass; }
+
+	void AddFixup( FIXUP_TYPE type, int address, int scope, SourceLine* sourceLine, CompiledExpression* expression );
+	void ResolveFixups( int start, int end );
+	void CheckDefinition( int scope, const std::string& symbolName ) const;
+	void AddForVariable( int scope, const std::string& symbolName );
+	inline void AddOuterReference( const std::string& symbolName ) { m_outerReferences.insert( symbolName ); }
+
+
+private:
+
+	struct Fixup
+	{
+		FIXUP_TYPE				m_type;
+		int						m_address;		// address of the instruction or data
+		int						m_scope;		// scope the expression was evaluated in
+		SourceLine*				m_sourceLine;
+		CompiledExpression*		m_expression;	// with everything known at the time folded in
+	};
+
+	SinglePass();
+	~SinglePass();
+
+	static int GetOperandOffset( FIXUP_TYPE type );
+	static int GetOperandSize( FIXUP_TYPE type );
+	void ResolveFixup( const Fixup& fixup ) const;
+	bool HidesOuterReference( int scope, const std::string& symbolName ) const;
+
+	std::vector< Fixup >		m_fixups;
+	std::set< std::string >		m_forVariables;		// names which have been used as FOR variables
+	std::set< std::string >		m_outerReferences;	// names which have been resolved in an outer scope
+
+};
+
+
+
+#endif // SINGLEPASS_H_
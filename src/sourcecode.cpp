@@ -33,6 +33,10 @@
 #include "lineparser.h"
 #include "symboltable.h"
 #include "macro.h"
+#include "linecache.h"
+#include "singlepass.h"
+#include "statistics.h"
+#include "instrumentation.h"
 
 using namespace std;
 
@@ -45,11 +49,12 @@ using namespace std;
 	Constructor for SourceCode
 
 	@param		pFilename		Filename of source file to open
+	@param		sourceId		Id under which the lines of the source are cached
 
 	The supplied file will be opened.  If there is a problem, an AsmException will be thrown.
 */
 /*************************************************************************************************/
-SourceCode::SourceCode( const string& filename, int lineNumber )
+SourceCode::SourceCode( const string& filename, int lineNumber, int sourceId )
 	:	m_forStackPtr( 0 ),
 		m_initialForStackPtr( 0 ),
 		m_ifStackPtr( 0 ),
@@ -57,7 +62,12 @@ SourceCode::SourceCode( const string& filename, int lineNumber )
 		m_currentMacro( NULL ),
 		m_filename( filename ),
 		m_lineNumber( lineNumber ),
-		m_lineStartPointer( 0 )
+		m_lineStartPointer( 0 ),
+		m_cachedLinePointer( 0 ),
+		m_filePointer( 0 ),
+		m_sourceId( sourceId ),
+		m_numLinesProcessed( 0 ),
+		m_pBuffer( NULL )
 {
 }
 
@@ -92,26 +102,40 @@ void SourceCode::Process()
 	m_initialForStackPtr = m_forStackPtr;
 	m_initialIfStackPtr = m_ifStackPtr;
 
-	// Iterate through the file line-by-line
+	// Iterate through the file line-by-line.  Each line is only read and lexed once; subsequent
+	// passes and FOR loop iterations replay it from the line cache.
 
-	string lineFromFile;
+	bool bInstrumented = Instrumentation::IsActive();
 
-	while ( GetLine( lineFromFile ) )
+	while ( true )
 	{
-		// Convert tabs to spaces
+		if ( bInstrumented )
+		{
+			Instrumentation::BeginLine( m_filename, m_lineNumber );
+		}
 
-		StringUtils::ExpandTabsToSpaces( lineFromFile, 8 );
+		m_lineStartPointer = m_filePointer;
+
+		SourceLine* line = GetSourceLine( m_lineStartPointer );
+
+		if ( line == NULL )
+		{
+			break;
+		}
+
+		m_cachedLinePointer = m_lineStartPointer;
+		m_filePointer = line->GetNextFilePointer();
 
 //		// Display and process
 //
 //		if ( GlobalData::Instance().IsFirstPass() )
 //		{
-//			cout << setw( 5 ) << m_lineNumber << ": " << lineFromFile << endl;
+//			cout << setw( 5 ) << m_lineNumber << ": " << line->GetText() << endl;
 //		}
 
 		try
 		{
-			LineParser thisLine( this, lineFromFile );
+			LineParser thisLine( this, *line );
 			thisLine.Process();
 		}
 		catch ( AsmException_SyntaxError& e )
@@ -123,14 +147,8 @@ void SourceCode::Process()
 		}
 
 		m_lineNumber++;
-		m_lineStartPointer = GetFilePointer();
-	}
-
-	// Check whether we aborted prematurely
-
-	if ( !IsAtEnd() )
-	{
-		throw AsmException_FileError_ReadSourceFile( m_filename );
+		m_numLinesProcessed++;
+		Statistics::Count( Statistics::LINES );
 	}
 
 	// Check that we have no FOR / braces mismatch
@@ -141,14 +159,14 @@ void SourceCode::Process()
 
 		if ( mismatchedFor.m_step == 0.0 )
 		{
-			AsmException_SyntaxError_MismatchedBraces e( mismatchedFor.m_line, mismatchedFor.m_column );
+			AsmException_SyntaxError_MismatchedBraces e( GetCachedLine( mismatchedFor.m_sourceId, mismatchedFor.m_lineStartPtr ), mismatchedFor.m_column );
 			e.SetFilename( m_filename );
 			e.SetLineNumber( mismatchedFor.m_lineNumber );
 			throw e;
 		}
 		else
 		{
-			AsmException_SyntaxError_ForWithoutNext e( mismatchedFor.m_line, mismatchedFor.m_column );
+			AsmException_SyntaxError_ForWithoutNext e( GetCachedLine( mismatchedFor.m_sourceId, mismatchedFor.m_lineStartPtr ), mismatchedFor.m_column );
 			e.SetFilename( m_filename );
 			e.SetLineNumber( mismatchedFor.m_lineNumber );
 			throw e;
@@ -163,14 +181,14 @@ void SourceCode::Process()
 
 		if ( mismatchedIf.m_isMacroDefinition )
 		{
-			AsmException_SyntaxError_NoEndMacro e( mismatchedIf.m_line, mismatchedIf.m_column );
+			AsmException_SyntaxError_NoEndMacro e( GetCachedLine( mismatchedIf.m_sourceId, mismatchedIf.m_lineStartPtr ), mismatchedIf.m_column );
 			e.SetFilename( m_filename );
 			e.SetLineNumber( mismatchedIf.m_lineNumber );
 			throw e;
 		}
 		else
 		{
-			AsmException_SyntaxError_IfWithoutEndif e( mismatchedIf.m_line, mismatchedIf.m_column );
+			AsmException_SyntaxError_IfWithoutEndif e( GetCachedLine( mismatchedIf.m_sourceId, mismatchedIf.m_lineStartPtr ), mismatchedIf.m_column );
 			e.SetFilename( m_filename );
 			e.SetLineNumber( mismatchedIf.m_lineNumber );
 			throw e;
@@ -180,6 +198,90 @@ void SourceCode::Process()
 
 
 
+/*************************************************************************************************/
+/**
+	SourceCode::GetSourceLine()
+
+	Returns the cached line starting at the given file pointer, reading it from the source buffer
+	and adding it to the line cache the first time it is needed
+
+	@param		filePointer		Offset of the start of the line
+
+	@return		SourceLine*		The line, or NULL at the end of the source
+*/
+/*************************************************************************************************/
+SourceLine* SourceCode::GetSourceLine( int filePointer )
+{
+	LineCache& lineCache = LineCache::Instance();
+
+	SourceLine* line = lineCache.Find( m_sourceId, filePointer );
+
+	if ( line == NULL )
+	{
+		string lineFromFile;
+		int nextFilePointer;
+
+		if ( !GetLine( filePointer, lineFromFile, nextFilePointer ) )
+		{
+			return NULL;
+		}
+
+		// Convert tabs to spaces
+
+		StringUtils::ExpandTabsToSpaces( lineFromFile, 8 );
+
+		line = lineCache.Add( m_sourceId, filePointer, lineFromFile, nextFilePointer );
+	}
+
+	return line;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceCode::GetLine()
+
+	Returns the line starting at the given file pointer in the source buffer.  As with getline(),
+	the line does not include its terminating newline, and a final line needs no terminator.
+
+	@param		filePointer		Offset of the start of the line
+	@param		lineFromFile	Receives the line
+	@param		nextFilePointer	Receives the offset of the following line
+
+	@return		bool			false if there was no line to read
+*/
+/*************************************************************************************************/
+bool SourceCode::GetLine( int filePointer, string& lineFromFile, int& nextFilePointer ) const
+{
+	assert( m_pBuffer != NULL );
+
+	const string& buffer = *m_pBuffer;
+	size_t start = static_cast< size_t >( filePointer );
+
+	if ( filePointer < 0 || start >= buffer.length() )
+	{
+		return false;
+	}
+
+	size_t end = buffer.find( '\n', start );
+
+	if ( end == string::npos )
+	{
+		lineFromFile.assign( buffer, start, string::npos );
+		nextFilePointer = static_cast< int >( buffer.length() );
+	}
+	else
+	{
+		lineFromFile.assign( buffer, start, end - start );
+		nextFilePointer = static_cast< int >( end + 1 );
+	}
+
+	return true;
+}
+
+
+
 /*************************************************************************************************/
 /**
 	SourceCode::AddFor()
@@ -200,7 +302,14 @@ void SourceCode::AddFor( const string& varName,
 
 	// Add symbol to table
 
-	SymbolTable::Instance().AddSymbol( varName, start );
+	int scope = GetDefinitionScope();
+
+	if ( GlobalData::Instance().IsSinglePass() )
+	{
+		SinglePass::Instance().AddForVariable( scope, varName );
+	}
+
+	SymbolTable::Instance().AddSymbol( scope, varName, start );
 
 	// Fill in FOR block
 
@@ -211,11 +320,15 @@ void SourceCode::AddFor( const string& varName,
 	m_forStack[ m_forStackPtr ].m_filePtr		= filePtr;
 	m_forStack[ m_forStackPtr ].m_id			= GlobalData::Instance().GetNextForId();
 	m_forStack[ m_forStackPtr ].m_count			= 0;
-	m_forStack[ m_forStackPtr ].m_line			= line;
+	m_forStack[ m_forStackPtr ].m_sourceId		= m_sourceId;
+	m_forStack[ m_forStackPtr ].m_lineStartPtr	= m_cachedLinePointer;
 	m_forStack[ m_forStackPtr ].m_column		= column;
 	m_forStack[ m_forStackPtr ].m_lineNumber	= m_lineNumber;
 
+	InitScope( m_forStackPtr );
 	m_forStackPtr++;
+
+	Instrumentation::BeginFor( m_filename, m_lineNumber );
 }
 
 
@@ -243,10 +356,12 @@ void SourceCode::OpenBrace( const string& line, int column )
 	m_forStack[ m_forStackPtr ].m_filePtr		= 0;
 	m_forStack[ m_forStackPtr ].m_id			= GlobalData::Instance().GetNextForId();
 	m_forStack[ m_forStackPtr ].m_count			= 0;
-	m_forStack[ m_forStackPtr ].m_line			= line;
+	m_forStack[ m_forStackPtr ].m_sourceId		= m_sourceId;
+	m_forStack[ m_forStackPtr ].m_lineStartPtr	= m_cachedLinePointer;
 	m_forStack[ m_forStackPtr ].m_column		= column;
 	m_forStack[ m_forStackPtr ].m_lineNumber	= m_lineNumber;
 
+	InitScope( m_forStackPtr );
 	m_forStackPtr++;
 }
 
@@ -273,21 +388,32 @@ void SourceCode::UpdateFor( const string& line, int column )
 		throw AsmException_SyntaxError_NextWithoutFor( line, column );
 	}
 
+	Statistics::Count( Statistics::FOR_ITERATIONS );
+
 	thisFor.m_current += thisFor.m_step;
 
+	// the loop variable lives in the scope enclosing the FOR
+
+	int outerScope = GetDefinitionScope( m_forStackPtr - 1 );
+
 	if ( ( thisFor.m_step > 0.0 && thisFor.m_current > thisFor.m_end ) ||
 		 ( thisFor.m_step < 0.0 && thisFor.m_current < thisFor.m_end ) )
 	{
 		// we have reached the end of the FOR
-		SymbolTable::Instance().RemoveSymbol( thisFor.m_varName );
+		SymbolTable::Instance().RemoveSymbol( outerScope, thisFor.m_varName );
+		ReleaseScope( m_forStackPtr - 1 );
 		m_forStackPtr--;
+
+		Instrumentation::EndFor( thisFor.m_count + 1 );
 	}
 	else
 	{
 		// reloop
-		SymbolTable::Instance().ChangeSymbol( thisFor.m_varName, thisFor.m_current );
+		SymbolTable::Instance().ChangeSymbol( outerScope, thisFor.m_varName, thisFor.m_current );
 		SetFilePointer( thisFor.m_filePtr );
+		ReleaseScope( m_forStackPtr - 1 );
 		thisFor.m_count++;
+		InitScope( m_forStackPtr - 1 );
 		m_lineNumber = thisFor.m_lineNumber - 1;
 	}
 }
@@ -325,6 +451,7 @@ void SourceCode::CloseBrace( const string& line, int column )
 		throw AsmException_SyntaxError_MismatchedBraces( line, column );
 	}
 
+	ReleaseScope( m_forStackPtr - 1 );
 	m_forStackPtr--;
 }
 
@@ -347,27 +474,143 @@ void SourceCode::CopyForStack( const SourceCode* copyFrom )
 
 /*************************************************************************************************/
 /**
-	SourceCode::GetSymbolNameSuffix()
+	SourceCode::GetScope()
+
+	Returns the symbol scope to look symbols up from at the given level of the FOR stack (by
+	default, the current level).  This is the innermost scope which exists at or below that level,
+	as levels without scopes of their own don't hold any symbols.
+*/
+/*************************************************************************************************/
+int SourceCode::GetScope( int level ) const
+{
+	if ( level == -1 )
+	{
+		level = m_forStackPtr;
+	}
+
+	return ( level == 0 ) ? static_cast< int >( SymbolTable::GLOBAL_SCOPE ) : m_forStack[ level - 1 ].m_lookupScope;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceCode::GetDefinitionScope()
+
+	Returns the scope to define symbols in at the given level of the FOR stack (by default, the
+	current level), creating a scope for that level, and any below it which don't have one yet
 */
 /*************************************************************************************************/
-string SourceCode::GetSymbolNameSuffix( int level ) const
+int SourceCode::GetDefinitionScope( int level )
 {
 	if ( level == -1 )
 	{
 		level = m_forStackPtr;
 	}
 
-	ostringstream suffix;
+	int scope = SymbolTable::GLOBAL_SCOPE;
 
-	for ( int i = 0; i < level; i++ )
+	for ( int i = 0; i < m_forStackPtr; i++ )
 	{
-		suffix << "@";
-		suffix << m_forStack[ i ].m_id;
-		suffix << "_";
-		suffix << m_forStack[ i ].m_count;
+		For& thisFor = m_forStack[ i ];
+
+		if ( i < level && thisFor.m_scope == -1 )
+		{
+			thisFor.m_scope = SymbolTable::Instance().GetScope( scope, thisFor.m_id, thisFor.m_count );
+		}
+
+		// levels above may have been looking symbols up from a scope below this one
+
+		thisFor.m_lookupScope = ( thisFor.m_scope != -1 ) ? thisFor.m_scope : GetScope( i );
+
+		if ( i < level )
+		{
+			scope = thisFor.m_scope;
+		}
 	}
 
-	return suffix.str();
+	return scope;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceCode::HasOwnScope()
+
+	Returns whether the current level of the FOR stack has a scope of its own, i.e. whether a
+	symbol found from GetScope() could be defined at this level rather than an outer one
+*/
+/*************************************************************************************************/
+bool SourceCode::HasOwnScope() const
+{
+	return ( m_forStackPtr == 0 || m_forStack[ m_forStackPtr - 1 ].m_scope != -1 );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceCode::InitScope()
+
+	Sets up the scopes of a newly opened FOR stack level.  It only gets a scope of its own when a
+	symbol is first defined in it, unless the previous pass already created one.
+
+	@param		level			Index of the level in the FOR stack
+*/
+/*************************************************************************************************/
+void SourceCode::InitScope( int level )
+{
+	For& thisFor = m_forStack[ level ];
+	int parent = ( level == 0 ) ? static_cast< int >( SymbolTable::GLOBAL_SCOPE ) : m_forStack[ level - 1 ].m_scope;
+
+	thisFor.m_scope = ( parent != -1 ) ? SymbolTable::Instance().FindScope( parent, thisFor.m_id, thisFor.m_count ) : -1;
+	thisFor.m_lookupScope = ( thisFor.m_scope != -1 ) ? thisFor.m_scope : GetScope( level );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceCode::ReleaseScope()
+
+	Called as a FOR stack level is closed, or moves on to its next iteration, so that its scope
+	can be freed if it didn't hold anything
+
+	@param		level			Index of the level in the FOR stack
+*/
+/*************************************************************************************************/
+void SourceCode::ReleaseScope( int level )
+{
+	if ( m_forStack[ level ].m_scope != -1 )
+	{
+		SymbolTable::Instance().ReleaseScope( m_forStack[ level ].m_scope );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SourceCode::GetCachedLine()
+
+	Fetches the text of a line from the line cache.  The FOR and IF stacks only record where each
+	level was opened, and this is used to recover the line if an error has to be reported there.
+
+	@param		sourceId		Id of the source containing the line
+	@param		filePointer		File pointer of the start of the line
+
+	@return		string			The line, with tabs expanded
+*/
+/*************************************************************************************************/
+string SourceCode::GetCachedLine( int sourceId, int filePointer )
+{
+	// The line was processed when the level was opened, so it will always be in the cache
+
+	SourceLine* line = LineCache::Instance().Find( sourceId, filePointer );
+	assert( line != NULL );
+
+	return ( line != NULL ) ? line->GetText() : string();
 }
 
 
@@ -408,7 +651,8 @@ void SourceCode::AddIfLevel( const string& line, int column )
 	m_ifStack[ m_ifStackPtr ].m_passed				= false;
 	m_ifStack[ m_ifStackPtr ].m_hadElse				= false;
 	m_ifStack[ m_ifStackPtr ].m_isMacroDefinition	= false;
-	m_ifStack[ m_ifStackPtr ].m_line				= line;
+	m_ifStack[ m_ifStackPtr ].m_sourceId			= m_sourceId;
+	m_ifStack[ m_ifStackPtr ].m_lineStartPtr		= m_cachedLinePointer;
 	m_ifStack[ m_ifStackPtr ].m_column				= column;
 	m_ifStack[ m_ifStackPtr ].m_lineNumber			= m_lineNumber;
 	m_ifStackPtr++;
@@ -506,7 +750,7 @@ void SourceCode::RemoveIfLevel( const string& line, int column )
 /*************************************************************************************************/
 void SourceCode::StartMacro( const string& line, int column )
 {
-	if ( GlobalData::Instance().IsFirstPass() )
+	if ( GlobalData::Instance().IsDefiningPass() )
 	{
 		if ( m_currentMacro == NULL )
 		{
@@ -531,7 +775,7 @@ void SourceCode::StartMacro( const string& line, int column )
 /*************************************************************************************************/
 void SourceCode::EndMacro( const string& line, int column )
 {
-	if ( GlobalData::Instance().IsFirstPass() &&
+	if ( GlobalData::Instance().IsDefiningPass() &&
 		 m_currentMacro == NULL )
 	{
 		throw AsmException_SyntaxError_EndMacroUnexpected( line, column - 8 );
@@ -539,8 +783,9 @@ void SourceCode::EndMacro( const string& line, int column )
 
 	RemoveIfLevel( line, column );
 
-	if ( GlobalData::Instance().IsFirstPass() )
+	if ( GlobalData::Instance().IsDefiningPass() )
 	{
+		m_currentMacro->SplitBody();
 		MacroTable::Instance().Add( m_currentMacro );
 		m_currentMacro = NULL;
 	}
@@ -28,6 +28,7 @@
 #include <vector>
 
 class Macro;
+class SourceLine;
 
 class SourceCode
 {
@@ -35,7 +36,7 @@ public:
 
 	// Constructor/destructor
 
-	SourceCode( const std::string& filename, int lineNumber );
+	SourceCode( const std::string& filename, int lineNumber, int sourceId );
 	~SourceCode();
 
 	// Process the file
@@ -47,11 +48,13 @@ public:
 	inline const std::string&	GetFilename() const				{ return m_filename; }
 	inline int				GetLineNumber() const			{ return m_lineNumber; }
 	inline int				GetLineStartPointer() const		{ return m_lineStartPointer; }
+	inline unsigned long	GetNumLinesProcessed() const	{ return m_numLinesProcessed; }
 
-	virtual std::istream&	GetLine( std::string& lineFromFile ) = 0;
-	virtual int				GetFilePointer() = 0;
-	virtual void			SetFilePointer( int i ) = 0;
-	virtual bool			IsAtEnd() = 0;
+	inline void				SetFilePointer( int i )			{ m_lineStartPointer = m_filePointer = i; }
+
+	bool					GetLine( int filePointer, std::string& lineFromFile, int& nextFilePointer ) const;
+
+	virtual SourceLine*		GetSourceLine( int filePointer );
 
 
 	// For loop / if related stuff
@@ -71,7 +74,10 @@ protected:
 		int					m_filePtr;
 		int					m_id;
 		int					m_count;
-		std::string			m_line;
+		int					m_scope;			// the level's own scope, or -1 until it needs one
+		int					m_lookupScope;		// the innermost scope at or below this level
+		int					m_sourceId;			// location of the FOR, from which the line text
+		int					m_lineStartPtr;		// can be fetched from the line cache if needed
 		int					m_column;
 		int					m_lineNumber;
 	};
@@ -86,7 +92,8 @@ protected:
 		bool                m_hadElse;
 		bool				m_passed;
 		bool				m_isMacroDefinition;
-		std::string			m_line;
+		int					m_sourceId;			// location of the IF, as above
+		int					m_lineStartPtr;
 		int					m_column;
 		int					m_lineNumber;
 	};
@@ -97,6 +104,10 @@ protected:
 
 	Macro*					m_currentMacro;
 
+	static std::string		GetCachedLine( int sourceId, int filePointer );
+	void					InitScope( int level );
+	void					ReleaseScope( int level );
+
 
 public:
 
@@ -119,7 +130,9 @@ public:
 	inline int 				GetInitialForStackPtr() const { return m_initialForStackPtr; }
 	inline Macro*			GetCurrentMacro() { return m_currentMacro; }
 
-	std::string				GetSymbolNameSuffix( int level = -1 ) const;
+	int						GetScope( int level = -1 ) const;
+	int						GetDefinitionScope( int level = -1 );
+	bool					HasOwnScope() const;
 
 	bool					IsIfConditionTrue() const;
 	void					AddIfLevel( const std::string& line, int column );
@@ -139,6 +152,11 @@ protected:
 	std::string				m_filename;
 	int						m_lineNumber;
 	int						m_lineStartPointer;
+	int						m_cachedLinePointer;	// start of the line being parsed, not moved by NEXT
+	int						m_filePointer;
+	int						m_sourceId;
+	unsigned long			m_numLinesProcessed;	// including repeats by FOR loops
+	const std::string*		m_pBuffer;		// the whole text of the source, set by subclasses
 };
 
 
@@ -32,6 +32,8 @@
 #include "globaldata.h"
 #include "lineparser.h"
 #include "symboltable.h"
+#include "linecache.h"
+#include "instrumentation.h"
 
 
 using namespace std;
@@ -46,21 +48,15 @@ using namespace std;
 
 	@param		pFilename		Filename of source file to open
 
-	The supplied file will be opened.  If there is a problem, an AsmException will be thrown.
+	The supplied file will be read into memory, unless an earlier pass has already done so.  If
+	there is a problem, an AsmException will be thrown.
 */
 /*************************************************************************************************/
 SourceFile::SourceFile( const string& filename )
-	:	SourceCode( filename, 1 )
+	:	SourceCode( filename, 1, LineCache::Instance().GetSourceId( filename ) )
 {
-	// we have to open in binary, due to a bug in MinGW which means that calling
-	// tellg() on a text-mode file ruins the file pointer!
-	// http://www.mingw.org/MinGWiki/index.php/Known%20Problems
-	m_file.open( filename.c_str(), ios_base::binary );
-
-	if ( !m_file )
-	{
-		throw AsmException_FileError_OpenSourceFile( filename );
-	}
+	m_pBuffer = &LineCache::Instance().LoadFile( m_sourceId, filename ).m_text;
+	GlobalData::Instance().AddInputFile( filename );
 }
 
 
@@ -71,12 +67,11 @@ SourceFile::SourceFile( const string& filename )
 
 	Destructor for SourceFile
 
-	The associated source file will be closed.
+	The file's contents stay in the line cache for subsequent passes.
 */
 /*************************************************************************************************/
 SourceFile::~SourceFile()
 {
-	m_file.close();
 }
 
 
@@ -89,7 +84,10 @@ SourceFile::~SourceFile()
 /*************************************************************************************************/
 void SourceFile::Process()
 {
-	SourceCode::Process();
+	{
+		InstrumentedSource instrumentedSource( m_filename, false, *this );
+		SourceCode::Process();
+	}
 
 	// Display ok message
 
@@ -98,60 +96,3 @@ void SourceFile::Process()
 		cerr << "Processed file '" << m_filename << "' ok" << endl;
 	}
 }
-
-
-
-/*************************************************************************************************/
-/**
-	SourceFile::GetLine()
-
-	Reads a line from the source code and returns it into lineFromFile
-*/
-/*************************************************************************************************/
-istream& SourceFile::GetLine( string& lineFromFile ) 
-{
-	return getline( m_file, lineFromFile );
-}
-
-
-
-/*************************************************************************************************/
-/**
-	SourceFile::GetFilePointer()
-
-	Returns the current file pointer
-*/
-/*************************************************************************************************/
-int SourceFile::GetFilePointer()
-{
-	return static_cast< int >( m_file.tellg() );
-}
-
-
-
-/*************************************************************************************************/
-/**
-	SourceFile::SetFilePointer()
-
-	Sets the current file pointer
-*/
-/*************************************************************************************************/
-void SourceFile::SetFilePointer( int i )
-{
-	m_lineStartPointer = i;
-	m_file.seekg( i );
-}
-
-
-
-/*************************************************************************************************/
-/**
-	SourceFile::IsAtEnd()
-
-	Returns whether the current stream is in an end-of-file state
-*/
-/*************************************************************************************************/
-bool SourceFile::IsAtEnd()
-{
-	return m_file.eof();
-}
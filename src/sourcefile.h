@@ -40,19 +40,6 @@ public:
 	virtual ~SourceFile();
 
 	virtual void Process();
-
-
-	// Accessors
-
-	virtual int				GetFilePointer();
-	virtual void			SetFilePointer( int i );
-	virtual std::istream&	GetLine( std::string& lineFromFile );
-	virtual bool			IsAtEnd();
-
-
-private:
-
-	std::ifstream			m_file;
 };
 
 
@@ -0,0 +1,383 @@
+/*************************************************************************************************/
+/**
+	statistics.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "statistics.h"
+#include "stringutils.h"
+
+
+using namespace std;
+
+
+const char* const Statistics::m_aCounterNames[ NUM_COUNTERS ] =
+{
+	"lines",
+	"expressions",
+	"symbol_lookups",
+	"symbol_inserts",
+	"symbol_changes",
+	"symbol_removals",
+	"macro_expansions",
+	"for_iterations"
+};
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::Create()
+
+	Creates the Statistics singleton
+*/
+/*************************************************************************************************/
+void Statistics::Create()
+{
+	assert( AssemblyContext::Current().m_pStatistics == NULL );
+
+	AssemblyContext::Current().m_pStatistics = new Statistics;
+	Instrumentation::Add( AssemblyContext::Current().m_pStatistics );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::Destroy()
+
+	Destroys the Statistics singleton
+*/
+/*************************************************************************************************/
+void Statistics::Destroy()
+{
+	assert( AssemblyContext::Current().m_pStatistics != NULL );
+
+	Instrumentation::Remove( AssemblyContext::Current().m_pStatistics );
+	delete AssemblyContext::Current().m_pStatistics;
+	AssemblyContext::Current().m_pStatistics = NULL;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::Statistics()
+
+	Statistics constructor
+*/
+/*************************************************************************************************/
+Statistics::Statistics()
+	:	m_bInPass( false ),
+		m_numBytesCounted( 0 )
+{
+	memset( m_aCounts, 0, sizeof m_aCounts );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::~Statistics()
+
+	Statistics destructor
+*/
+/*************************************************************************************************/
+Statistics::~Statistics()
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::BeginPass()
+
+	Starts timing a pass, and counting what it does
+
+	@param		name			Name of the pass, as reported
+*/
+/*************************************************************************************************/
+void Statistics::BeginPass( const string& name )
+{
+	EndPass();
+
+	Pass pass;
+	pass.m_name = name;
+	pass.m_seconds = 0.0;
+	m_passes.push_back( pass );
+
+	memset( m_aCounts, 0, sizeof m_aCounts );
+	m_bInPass = true;
+	m_passStart = Clock::now();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::EndPass()
+
+	Finishes the current pass, if there is one, recording how long it took and what it did.  This
+	is also called when an error stops a pass part way through.
+*/
+/*************************************************************************************************/
+void Statistics::EndPass()
+{
+	if ( !m_bInPass )
+	{
+		return;
+	}
+
+	Pass& pass = m_passes.back();
+	pass.m_seconds = chrono::duration< double >( Clock::now() - m_passStart ).count();
+	memcpy( pass.m_aCounts, m_aCounts, sizeof m_aCounts );
+
+	m_bInPass = false;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::EnterSource()
+
+	Counts a macro expansion
+
+	@param		name			Filename, or macro name
+	@param		bIsMacro		Whether it is a macro instance
+*/
+/*************************************************************************************************/
+void Statistics::EnterSource( const string&, bool bIsMacro )
+{
+	if ( bIsMacro )
+	{
+		m_aCounts[ MACRO_EXPANSIONS ]++;
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::ExitSource()
+
+	Records the lines processed by one SourceFile or MacroInstance
+
+	@param		name			Filename, or macro name
+	@param		bIsMacro		Whether it is a macro instance
+	@param		numLines		Number of lines processed, counting each FOR iteration
+*/
+/*************************************************************************************************/
+void Statistics::ExitSource( const string& name, bool bIsMacro, unsigned long numLines )
+{
+	m_sourceLines[ bIsMacro ? "MACRO " + name : name ] += numLines;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::AddDirective()
+
+	Records one directive or instruction being assembled
+
+	@param		pName			The directive or instruction
+	@param		bytes			Number of bytes it put, not counting those of any nested directives
+*/
+/*************************************************************************************************/
+void Statistics::AddDirective( const char* pName, unsigned long bytes )
+{
+	Directive& directive = m_directives[ pName ];
+
+	directive.m_count++;
+	directive.m_bytes += bytes;
+	m_numBytesCounted += bytes;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SortByCount()
+
+	Sorts name/count pairs with the largest count first
+*/
+/*************************************************************************************************/
+template< class T >
+static bool SortByCount( const pair< string, T >& a, const pair< string, T >& b )
+{
+	return a.second > b.second;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SortByBytes()
+
+	Sorts directives with the most bytes first, then the most used
+*/
+/*************************************************************************************************/
+template< class T >
+static bool SortByBytes( const pair< string, T >& a, const pair< string, T >& b )
+{
+	if ( a.second.m_bytes != b.second.m_bytes )
+	{
+		return a.second.m_bytes > b.second.m_bytes;
+	}
+
+	return a.second.m_count > b.second.m_count;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::Report()
+
+	Writes the statistics out in a readable table
+
+	@param		stream			Where to write them
+*/
+/*************************************************************************************************/
+void Statistics::Report( ostream& stream ) const
+{
+	char buffer[ 256 ];
+
+	stream << "Assembly statistics" << endl << endl;
+
+	sprintf( buffer, "%-18s", "" );
+	stream << buffer;
+
+	for ( vector< Pass >::const_iterator it = m_passes.begin(); it != m_passes.end(); ++it )
+	{
+		sprintf( buffer, " %14s", it->m_name.c_str() );
+		stream << buffer;
+	}
+
+	stream << endl;
+
+	sprintf( buffer, "%-18s", "seconds" );
+	stream << buffer;
+
+	for ( vector< Pass >::const_iterator it = m_passes.begin(); it != m_passes.end(); ++it )
+	{
+		sprintf( buffer, " %14.6f", it->m_seconds );
+		stream << buffer;
+	}
+
+	stream << endl;
+
+	for ( int i = 0; i < NUM_COUNTERS; i++ )
+	{
+		string name = m_aCounterNames[ i ];
+		replace( name.begin(), name.end(), '_', ' ' );
+		sprintf( buffer, "%-18s", name.c_str() );
+		stream << buffer;
+
+		for ( vector< Pass >::const_iterator it = m_passes.begin(); it != m_passes.end(); ++it )
+		{
+			sprintf( buffer, " %14lu", it->m_aCounts[ i ] );
+			stream << buffer;
+		}
+
+		stream << endl;
+	}
+
+	// The rest is totalled over all the passes
+
+	vector< pair< string, unsigned long > > sources( m_sourceLines.begin(), m_sourceLines.end() );
+	stable_sort( sources.begin(), sources.end(), SortByCount< unsigned long > );
+
+	stream << endl << "Lines processed, all passes:" << endl;
+
+	for ( vector< pair< string, unsigned long > >::const_iterator it = sources.begin(); it != sources.end(); ++it )
+	{
+		sprintf( buffer, "%14lu  ", it->second );
+		stream << buffer << it->first << endl;
+	}
+
+	vector< pair< string, Directive > > directives( m_directives.begin(), m_directives.end() );
+	stable_sort( directives.begin(), directives.end(), SortByBytes< Directive > );
+
+	stream << endl << "Directives and instructions, all passes:" << endl;
+	sprintf( buffer, "%14s %14s  %s", "count", "bytes", "name" );
+	stream << buffer << endl;
+
+	for ( vector< pair< string, Directive > >::const_iterator it = directives.begin(); it != directives.end(); ++it )
+	{
+		sprintf( buffer, "%14lu %14lu  ", it->second.m_count, it->second.m_bytes );
+		stream << buffer << it->first << endl;
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Statistics::WriteJson()
+
+	Writes the statistics out as JSON
+
+	@param		stream			Where to write them
+*/
+/*************************************************************************************************/
+void Statistics::WriteJson( ostream& stream ) const
+{
+	char buffer[ 64 ];
+
+	stream << "{" << endl << "  \"passes\": [" << endl;
+
+	for ( vector< Pass >::const_iterator it = m_passes.begin(); it != m_passes.end(); ++it )
+	{
+		sprintf( buffer, "%.6f", it->m_seconds );
+		stream << "    { \"name\": " << StringUtils::QuoteJson( it->m_name ) << ", \"seconds\": " << buffer;
+
+		for ( int i = 0; i < NUM_COUNTERS; i++ )
+		{
+			stream << ", \"" << m_aCounterNames[ i ] << "\": " << it->m_aCounts[ i ];
+		}
+
+		stream << " }" << ( it + 1 != m_passes.end() ? "," : "" ) << endl;
+	}
+
+	stream << "  ]," << endl << "  \"sources\": [" << endl;
+
+	for ( map< string, unsigned long >::const_iterator it = m_sourceLines.begin(); it != m_sourceLines.end(); )
+	{
+		stream << "    { \"name\": " << StringUtils::QuoteJson( it->first ) << ", \"lines\": " << it->second << " }";
+		stream << ( ++it != m_sourceLines.end() ? "," : "" ) << endl;
+	}
+
+	stream << "  ]," << endl << "  \"directives\": [" << endl;
+
+	for ( map< string, Directive >::const_iterator it = m_directives.begin(); it != m_directives.end(); )
+	{
+		stream << "    { \"name\": " << StringUtils::QuoteJson( it->first ) << ", \"count\": " << it->second.m_count
+			   << ", \"bytes\": " << it->second.m_bytes << " }";
+		stream << ( ++it != m_directives.end() ? "," : "" ) << endl;
+	}
+
+	stream << "  ]" << endl << "}" << endl;
+}
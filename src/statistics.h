@@ -0,0 +1,120 @@
+/*************************************************************************************************/
+/**
+	statistics.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef STATISTICS_H_
+#define STATISTICS_H_
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "instrumentation.h"
+
+
+// Counts of what the assembler did, and how long each pass took, as reported by --stats
+
+class Statistics : public Instrument
+{
+public:
+
+	enum COUNTER
+	{
+		LINES,
+		EXPRESSIONS,
+		SYMBOL_LOOKUPS,
+		SYMBOL_INSERTS,
+		SYMBOL_CHANGES,
+		SYMBOL_REMOVALS,
+		MACRO_EXPANSIONS,
+		FOR_ITERATIONS,
+		NUM_COUNTERS
+	};
+
+	static void Create();
+	static void Destroy();
+	static inline Statistics* Get() { return AssemblyContext::Current().m_pStatistics; }
+
+	virtual void BeginPass( const std::string& name );
+	virtual void EndPass();
+	virtual void EnterSource( const std::string& name, bool bIsMacro );
+	virtual void ExitSource( const std::string& name, bool bIsMacro, unsigned long numLines );
+
+	static inline void Count( COUNTER counter )
+	{
+		Statistics* pStatistics = Get();
+
+		if ( pStatistics != NULL )
+		{
+			pStatistics->m_aCounts[ counter ]++;
+		}
+	}
+
+	// Bytes are counted against the innermost directive which put them, so that INCLUDE doesn't
+	// also count the bytes put by the file it includes
+
+	void AddDirective( const char* pName, unsigned long bytes );
+	inline unsigned long GetNumBytesCounted() const	{ return m_numBytesCounted; }
+
+	void Report( std::ostream& stream ) const;
+	void WriteJson( std::ostream& stream ) const;
+
+
+private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Pass
+	{
+		std::string			m_name;
+		double				m_seconds;
+		unsigned long		m_aCounts[ NUM_COUNTERS ];
+	};
+
+	struct Directive
+	{
+		Directive() : m_count( 0 ), m_bytes( 0 ) {}
+
+		unsigned long		m_count;
+		unsigned long		m_bytes;
+	};
+
+	Statistics();
+	virtual ~Statistics();
+
+	static const char* const				m_aCounterNames[ NUM_COUNTERS ];
+
+	std::vector< Pass >						m_passes;
+	bool									m_bInPass;
+	Clock::time_point						m_passStart;
+	unsigned long							m_aCounts[ NUM_COUNTERS ];		// in the current pass
+
+	std::map< std::string, unsigned long >	m_sourceLines;
+	std::map< std::string, Directive >		m_directives;
+	unsigned long							m_numBytesCounted;
+};
+
+
+
+#endif // STATISTICS_H_
@@ -20,6 +20,7 @@
 */
 /*************************************************************************************************/
 
+#include <cstdio>
 #include <iostream>
 #include "stringutils.h"
 
@@ -91,4 +92,45 @@ bool EatWhitespace( const string& line, size_t& column )
 
 
 
+/*************************************************************************************************/
+/**
+	QuoteJson()
+
+	Quotes a string for JSON
+
+	@param		text			The string
+
+	@return		string			The quoted string
+*/
+/*************************************************************************************************/
+string QuoteJson( const string& text )
+{
+	string quoted = "\"";
+
+	for ( string::const_iterator it = text.begin(); it != text.end(); ++it )
+	{
+		unsigned char c = static_cast< unsigned char >( *it );
+
+		if ( c == '"' || c == '\\' )
+		{
+			quoted += '\\';
+			quoted += c;
+		}
+		else if ( c < 0x20 )
+		{
+			char escaped[ 8 ];
+			sprintf( escaped, "\\u%04x", c );
+			quoted += escaped;
+		}
+		else
+		{
+			quoted += c;
+		}
+	}
+
+	return quoted + "\"";
+}
+
+
+
 } // namespace StringUtils
@@ -20,6 +20,7 @@
 */
 /*************************************************************************************************/
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <iostream>
@@ -27,12 +28,12 @@
 
 #include "symboltable.h"
 #include "constants.h"
+#include "statistics.h"
 
 
 using namespace std;
 
 
-SymbolTable* SymbolTable::m_gInstance = NULL;
 
 
 /*************************************************************************************************/
@@ -44,9 +45,9 @@ SymbolTable* SymbolTable::m_gInstance = NULL;
 /*************************************************************************************************/
 void SymbolTable::Create()
 {
-	assert( m_gInstance == NULL );
+	assert( AssemblyContext::Current().m_pSymbolTable == NULL );
 
-	m_gInstance = new SymbolTable;
+	AssemblyContext::Current().m_pSymbolTable = new SymbolTable;
 }
 
 
@@ -60,10 +61,10 @@ void SymbolTable::Create()
 /*************************************************************************************************/
 void SymbolTable::Destroy()
 {
-	assert( m_gInstance != NULL );
+	assert( AssemblyContext::Current().m_pSymbolTable != NULL );
 
-	delete m_gInstance;
-	m_gInstance = NULL;
+	delete AssemblyContext::Current().m_pSymbolTable;
+	AssemblyContext::Current().m_pSymbolTable = NULL;
 }
 
 
@@ -76,13 +77,28 @@ void SymbolTable::Destroy()
 */
 /*************************************************************************************************/
 SymbolTable::SymbolTable()
+	:	m_firstFree( -1 ),
+		m_numSymbols( 0 ),
+		m_generation( 0 )
 {
+	Rehash( 256 );
+
+	// The global scope has no parent
+
+	Scope global;
+	global.m_parent = -1;
+	global.m_id = -1;
+	global.m_count = 0;
+	global.m_numSymbols = 0;
+	global.m_numChildren = 0;
+	global.m_isHeld = true;
+	m_scopes.push_back( global );
+
 	// Add any constant symbols here
 
-	AddSymbol( "PI", const_pi );
-	AddSymbol( "P%", 0 );
-	AddSymbol( "TRUE", -1 );
-	AddSymbol( "FALSE", 0 );
+	AddBuiltInSymbol( "PI", const_pi );
+	AddBuiltInSymbol( "TRUE", -1 );
+	AddBuiltInSymbol( "FALSE", 0 );
 }
 
 
@@ -100,19 +116,125 @@ SymbolTable::~SymbolTable()
 
 
 
+/*************************************************************************************************/
+/**
+	SymbolTable::GetScope()
+
+	Returns the scope opened by a FOR iteration, pair of braces or macro instance, creating it the
+	first time it is seen
+
+	@param		parent			The scope in which the FOR/brace was opened
+	@param		id				The id of the FOR/brace
+	@param		count			The iteration count
+	@returns	int
+*/
+/*************************************************************************************************/
+int SymbolTable::GetScope( int parent, int id, int count )
+{
+	pair<int, pair<int, int> > key( parent, make_pair( id, count ) );
+	map<pair<int, pair<int, int> >, int>::iterator it = m_scopeIds.find( key );
+
+	if ( it != m_scopeIds.end() )
+	{
+		return it->second;
+	}
+
+	Scope scope;
+	scope.m_parent = parent;
+	scope.m_id = id;
+	scope.m_count = count;
+	scope.m_numSymbols = 0;
+	scope.m_numChildren = 0;
+	scope.m_isHeld = false;
+
+	int scopeId;
+
+	if ( !m_freeScopes.empty() )
+	{
+		scopeId = m_freeScopes.back();
+		m_freeScopes.pop_back();
+		m_scopes[ scopeId ] = scope;
+	}
+	else
+	{
+		scopeId = static_cast< int >( m_scopes.size() );
+		m_scopes.push_back( scope );
+	}
+
+	m_scopes[ parent ].m_numChildren++;
+	m_scopeIds.insert( make_pair( key, scopeId ) );
+
+	return scopeId;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::FindScope()
+
+	As GetScope(), but only finds a scope which already exists
+
+	@param		parent			The scope in which the FOR/brace was opened
+	@param		id				The id of the FOR/brace
+	@param		count			The iteration count
+	@returns	int				The scope, or -1 if there isn't one
+*/
+/*************************************************************************************************/
+int SymbolTable::FindScope( int parent, int id, int count ) const
+{
+	map<pair<int, pair<int, int> >, int>::const_iterator it = m_scopeIds.find( make_pair( parent, make_pair( id, count ) ) );
+
+	return ( it != m_scopeIds.end() ) ? it->second : -1;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::ReleaseScope()
+
+	Called when the FOR iteration, braces or macro instance which opened a scope is closed.  If
+	the scope holds no symbols, and no other scope is inside it, it will never be needed again, so
+	it is freed for reuse.
+
+	@param		scope			The scope
+*/
+/*************************************************************************************************/
+void SymbolTable::ReleaseScope( int scope )
+{
+	Scope& entry = m_scopes[ scope ];
+
+	if ( entry.m_numSymbols != 0 || entry.m_numChildren != 0 || entry.m_isHeld )
+	{
+		return;
+	}
+
+	m_scopeIds.erase( make_pair( entry.m_parent, make_pair( entry.m_id, entry.m_count ) ) );
+	m_scopes[ entry.m_parent ].m_numChildren--;
+	m_freeScopes.push_back( scope );
+
+	// the id may be reused for another scope, so handles found from this one are no longer valid
+
+	m_generation++;
+}
+
+
+
 /*************************************************************************************************/
 /**
 	SymbolTable::IsSymbolDefined()
 
-	Returns whether or not the supplied symbol exists in the symbol table
+	Returns whether or not the supplied symbol exists in the given scope
 
+	@param		scope			The scope to search
 	@param		symbol			The symbol to search for
 	@returns	bool
 */
 /*************************************************************************************************/
-bool SymbolTable::IsSymbolDefined( const std::string& symbol ) const
+bool SymbolTable::IsSymbolDefined( int scope, const std::string& symbol ) const
 {
-	return ( m_map.count( symbol ) == 1 );
+	return ( FindSymbol( scope, symbol ) != -1 );
 }
 
 
@@ -123,14 +245,57 @@ bool SymbolTable::IsSymbolDefined( const std::string& symbol ) const
 
 	Adds a symbol to the symbol table with the supplied value
 
+	@param		scope			The scope to add it to
 	@param		symbol			The symbol to add
 	@param		int				Its value
 */
 /*************************************************************************************************/
-void SymbolTable::AddSymbol( const std::string& symbol, double value, bool isLabel )
+void SymbolTable::AddSymbol( int scope, const std::string& symbol, double value, bool isLabel )
 {
-	assert( !IsSymbolDefined( symbol ) );
-	m_map.insert( make_pair( symbol, Symbol( value, isLabel ) ) );
+	assert( !IsSymbolDefined( scope, symbol ) );
+	Insert( scope, symbol, value, isLabel );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::AddBuiltInSymbol()
+
+	Adds a global symbol which is defined by the assembler rather than the source, and so isn't
+	returned by GetGlobalSymbols()
+
+	@param		symbol			The symbol to add
+	@param		value			Its value
+*/
+/*************************************************************************************************/
+void SymbolTable::AddBuiltInSymbol( const std::string& symbol, double value )
+{
+	assert( !IsSymbolDefined( GLOBAL_SCOPE, symbol ) );
+	Insert( GLOBAL_SCOPE, symbol, value, false );
+	m_symbols[ FindSymbol( GLOBAL_SCOPE, symbol ) ].m_isBuiltIn = true;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::AddBoundSymbol()
+
+	Adds a read-only symbol whose value always reflects the supplied variable
+
+	@param		symbol			The symbol to add
+	@param		pValue			Pointer to the variable holding its value
+*/
+/*************************************************************************************************/
+void SymbolTable::AddBoundSymbol( const std::string& symbol, const int* pValue )
+{
+	assert( !IsSymbolDefined( GLOBAL_SCOPE, symbol ) );
+	assert( pValue != NULL );
+	Insert( GLOBAL_SCOPE, symbol, 0.0, false );
+	Symbol& entry = m_symbols[ FindSymbol( GLOBAL_SCOPE, symbol ) ];
+	entry.m_pBinding = pValue;
+	entry.m_isBuiltIn = true;
 }
 
 
@@ -173,7 +338,7 @@ bool SymbolTable::AddCommandLineSymbol( const std::string& expr )
 			return false;
 		}
 	}
-	if ( IsSymbolDefined( symbol ) )
+	if ( IsSymbolDefined( GLOBAL_SCOPE, symbol ) )
 	{
 		return false;
 	}
@@ -252,7 +417,7 @@ bool SymbolTable::AddCommandLineSymbol( const std::string& expr )
 		return false;
 	}
 
-	m_map.insert( make_pair( symbol, Symbol( value, false ) ) );
+	Insert( GLOBAL_SCOPE, symbol, value, false );
 
 	return true;
 }
@@ -265,13 +430,15 @@ bool SymbolTable::AddCommandLineSymbol( const std::string& expr )
 
 	Gets the value of a symbol which already exists in the symbol table
 
+	@param		scope			The scope containing the symbol
 	@param		symbol			The name of the symbol to look for
 */
 /*************************************************************************************************/
-double SymbolTable::GetSymbol( const std::string& symbol ) const
+double SymbolTable::GetSymbol( int scope, const std::string& symbol ) const
 {
-	assert( IsSymbolDefined( symbol ) );
-	return m_map.find( symbol )->second.GetValue();
+	int handle = FindSymbol( scope, symbol );
+	assert( handle != -1 );
+	return GetSymbolValue( handle );
 }
 
 
@@ -282,14 +449,17 @@ double SymbolTable::GetSymbol( const std::string& symbol ) const
 
 	Changes the value of a symbol which already exists in the symbol table
 
+	@param		scope			The scope containing the symbol
 	@param		symbol			The name of the symbol to look for
 	@param		value			Its new value
 */
 /*************************************************************************************************/
-void SymbolTable::ChangeSymbol( const std::string& symbol, double value )
+void SymbolTable::ChangeSymbol( int scope, const std::string& symbol, double value )
 {
-	assert( IsSymbolDefined( symbol ) );
-	m_map.find( symbol )->second.SetValue( value );
+	int handle = FindSymbol( scope, symbol );
+	assert( handle != -1 );
+	SetSymbolValue( handle, value );
+	Statistics::Count( Statistics::SYMBOL_CHANGES );
 }
 
 
@@ -300,13 +470,250 @@ void SymbolTable::ChangeSymbol( const std::string& symbol, double value )
 
 	Removes the named symbol
 
+	@param		scope			The scope containing the symbol
 	@param		symbol			The name of the symbol to look for
 */
 /*************************************************************************************************/
-void SymbolTable::RemoveSymbol( const std::string& symbol )
+void SymbolTable::RemoveSymbol( int scope, const std::string& symbol )
+{
+	Statistics::Count( Statistics::SYMBOL_REMOVALS );
+
+	m_generation++;
+
+	unsigned int hash = Hash( scope, Hash( symbol.data(), symbol.length() ) );
+	int* link = &m_buckets[ hash & ( m_buckets.size() - 1 ) ];
+
+	while ( *link != -1 )
+	{
+		Symbol& entry = m_symbols[ *link ];
+
+		if ( entry.m_hash == hash && entry.m_scope == scope && entry.m_name == symbol )
+		{
+			// Unlink it from its bucket and put the slot on the free list
+
+			int handle = *link;
+			*link = entry.m_next;
+			entry.m_isUsed = false;
+			entry.m_next = m_firstFree;
+			m_firstFree = handle;
+			m_numSymbols--;
+			m_scopes[ scope ].m_numSymbols--;
+			return;
+		}
+
+		link = &entry.m_next;
+	}
+
+	assert( false );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::Hash()
+
+	Hashes a symbol name (32-bit FNV-1a)
+
+	@param		symbol			Pointer to the symbol name
+	@param		length			Length of the symbol name
+	@returns	unsigned int
+*/
+/*************************************************************************************************/
+unsigned int SymbolTable::Hash( const char* symbol, size_t length )
+{
+	unsigned int hash = 2166136261u;
+
+	for ( size_t i = 0; i < length; i++ )
+	{
+		hash ^= static_cast< unsigned char >( symbol[ i ] );
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::FindSymbol()
+
+	Looks up a symbol in a single scope without needing to construct a std::string
+
+	@param		scope			The scope to search
+	@param		symbol			Pointer to the symbol name
+	@param		length			Length of the symbol name
+	@returns	int				Handle to the symbol, or -1 if it is not defined
+*/
+/*************************************************************************************************/
+int SymbolTable::FindSymbol( int scope, const char* symbol, size_t length ) const
+{
+	Statistics::Count( Statistics::SYMBOL_LOOKUPS );
+	return FindSymbol( scope, Hash( symbol, length ), symbol, length );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::ResolveSymbol()
+
+	Looks up a symbol as seen from the given scope, i.e. searching it and then its enclosing
+	scopes in turn
+
+	@param		scope			The innermost scope to search
+	@param		symbol			Pointer to the symbol name
+	@param		length			Length of the symbol name
+	@returns	int				Handle to the symbol, or -1 if it is not defined
+*/
+/*************************************************************************************************/
+int SymbolTable::ResolveSymbol( int scope, const char* symbol, size_t length ) const
+{
+	return ResolveSymbol( scope, Hash( symbol, length ), symbol, length );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::ResolveSymbol()
+
+	As above, given the hash of the symbol name
+*/
+/*************************************************************************************************/
+int SymbolTable::ResolveSymbol( int scope, unsigned int nameHash, const char* symbol, size_t length ) const
 {
-	assert( IsSymbolDefined( symbol ) );
-	m_map.erase( symbol );
+	Statistics::Count( Statistics::SYMBOL_LOOKUPS );
+
+	for ( ; scope != -1; scope = m_scopes[ scope ].m_parent )
+	{
+		int handle = FindSymbol( scope, nameHash, symbol, length );
+
+		if ( handle != -1 )
+		{
+			return handle;
+		}
+	}
+
+	return -1;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::FindSymbol()
+
+	Looks up a symbol in a single scope, given the hash of its name
+*/
+/*************************************************************************************************/
+int SymbolTable::FindSymbol( int scope, unsigned int nameHash, const char* symbol, size_t length ) const
+{
+	unsigned int hash = Hash( scope, nameHash );
+
+	for ( int i = m_buckets[ hash & ( m_buckets.size() - 1 ) ]; i != -1; i = m_symbols[ i ].m_next )
+	{
+		const Symbol& entry = m_symbols[ i ];
+
+		if ( entry.m_hash == hash &&
+			 entry.m_scope == scope &&
+			 entry.m_name.length() == length &&
+			 entry.m_name.compare( 0, length, symbol, length ) == 0 )
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::Insert()
+
+	Adds a new entry for a symbol which is known not to exist yet
+
+	@param		scope			The scope to add it to
+	@param		symbol			The symbol to add
+	@param		value			Its value
+	@param		isLabel			Whether it is a label (and so should be dumped by -d)
+*/
+/*************************************************************************************************/
+void SymbolTable::Insert( int scope, const std::string& symbol, double value, bool isLabel )
+{
+	Statistics::Count( Statistics::SYMBOL_INSERTS );
+
+	m_generation++;
+
+	if ( m_numSymbols >= m_buckets.size() )
+	{
+		Rehash( m_buckets.size() * 2 );
+	}
+
+	int handle;
+
+	if ( m_firstFree != -1 )
+	{
+		handle = m_firstFree;
+		m_firstFree = m_symbols[ handle ].m_next;
+	}
+	else
+	{
+		handle = static_cast< int >( m_symbols.size() );
+		m_symbols.push_back( Symbol() );
+	}
+
+	Symbol& entry = m_symbols[ handle ];
+	size_t bucket;
+
+	entry.m_name	= symbol;
+	entry.m_scope	= scope;
+	entry.m_hash	= Hash( scope, Hash( symbol.data(), symbol.length() ) );
+	entry.m_value	= value;
+	entry.m_isLabel	= isLabel;
+	entry.m_isUsed	= true;
+	entry.m_isBuiltIn	= false;
+	entry.m_pBinding	= NULL;
+
+	bucket = entry.m_hash & ( m_buckets.size() - 1 );
+	entry.m_next = m_buckets[ bucket ];
+	m_buckets[ bucket ] = handle;
+
+	m_numSymbols++;
+	m_scopes[ scope ].m_numSymbols++;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::Rehash()
+
+	Redistributes all the symbols over a new number of hash buckets
+
+	@param		numBuckets		New number of buckets (must be a power of 2)
+*/
+/*************************************************************************************************/
+void SymbolTable::Rehash( size_t numBuckets )
+{
+	assert( ( numBuckets & ( numBuckets - 1 ) ) == 0 );
+
+	m_buckets.assign( numBuckets, -1 );
+
+	for ( size_t i = 0; i < m_symbols.size(); i++ )
+	{
+		Symbol& entry = m_symbols[ i ];
+
+		if ( entry.m_isUsed )
+		{
+			size_t bucket = entry.m_hash & ( numBuckets - 1 );
+			entry.m_next = m_buckets[ bucket ];
+			m_buckets[ bucket ] = static_cast< int >( i );
+		}
+	}
 }
 
 
@@ -320,28 +727,62 @@ void SymbolTable::RemoveSymbol( const std::string& symbol )
 /*************************************************************************************************/
 void SymbolTable::Dump() const
 {
+	// Symbols are stored in no particular order, so sort the ones we want to output by name
+
+	vector<const Symbol*> labels;
+
+	for ( vector<Symbol>::const_iterator it = m_symbols.begin(); it != m_symbols.end(); ++it )
+	{
+		if ( it->m_isUsed &&
+			 it->m_isLabel &&
+			 it->m_scope == GLOBAL_SCOPE )
+		{
+			labels.push_back( &*it );
+		}
+	}
+
+	sort( labels.begin(), labels.end(), CompareSymbolNames );
+
 	cout << "[{";
 
 	bool bFirst = true;
 
-	for ( map<string, Symbol>::const_iterator it = m_map.begin(); it != m_map.end(); ++it )
+	for ( vector<const Symbol*>::const_iterator it = labels.begin(); it != labels.end(); ++it )
 	{
-		const string&	symbolName = it->first;
-		const Symbol&	symbol = it->second;
-
-		if ( symbol.IsLabel() &&
-			 symbolName.find_first_of( '@' ) == string::npos )
+		if ( !bFirst )
 		{
-			if ( !bFirst )
-			{
-				cout << ",";
-			}
+			cout << ",";
+		}
 
-			cout << "'" << symbolName << "':" << symbol.GetValue() << "L";
+		cout << "'" << (*it)->m_name << "':" << (*it)->m_value << "L";
 
-			bFirst = false;
-		}
+		bFirst = false;
 	}
 
 	cout << "}]" << endl;
 }
+
+
+
+/*************************************************************************************************/
+/**
+	SymbolTable::GetGlobalSymbols()
+
+	Gets the values of all the symbols in the global scope, except for the built-in ones such as
+	PI or P%, which are defined by the assembler itself
+
+	@param		symbols			Map to add the symbols to
+*/
+/*************************************************************************************************/
+void SymbolTable::GetGlobalSymbols( map<string, double>& symbols ) const
+{
+	for ( vector<Symbol>::const_iterator it = m_symbols.begin(); it != m_symbols.end(); ++it )
+	{
+		if ( it->m_isUsed &&
+			 it->m_scope == GLOBAL_SCOPE &&
+			 !it->m_isBuiltIn )
+		{
+			symbols[ it->m_name ] = it->m_value;
+		}
+	}
+}
@@ -27,6 +27,8 @@
 #include <cstdlib>
 #include <map>
 #include <string>
+#include <vector>
+#include "assemblycontext.h"
 
 
 class SymbolTable
@@ -35,42 +37,112 @@ public:
 
 	static void Create();
 	static void Destroy();
-	static inline SymbolTable& Instance() { assert( m_gInstance != NULL ); return *m_gInstance; }
+	static inline SymbolTable& Instance() { assert( AssemblyContext::Current().m_pSymbolTable != NULL ); return *AssemblyContext::Current().m_pSymbolTable; }
 
-	void AddSymbol( const std::string& symbol, double value, bool isLabel = false );
-	bool AddCommandLineSymbol( const std::string& expr );
-	void ChangeSymbol( const std::string& symbol, double value );
-	double GetSymbol( const std::string& symbol ) const;
-	bool IsSymbolDefined( const std::string& symbol ) const;
-	void RemoveSymbol( const std::string& symbol );
+	// Symbols live in scopes.  Each FOR loop iteration, pair of braces and macro instance which
+	// has a symbol defined in it gets its own scope, identified by the scope it was opened in, the
+	// id of the FOR/brace and the iteration count; both passes see the same ids, so they arrive at
+	// the same scopes.  A scope which is left without symbols is freed when it is closed, unless
+	// it is held.
 
-	void Dump() const;
+	enum { GLOBAL_SCOPE = 0 };
 
+	int GetScope( int parent, int id, int count );
+	int FindScope( int parent, int id, int count ) const;
+	void ReleaseScope( int scope );
+	inline void HoldScope( int scope )				{ m_scopes[ scope ].m_isHeld = true; }
+	inline int GetParentScope( int scope ) const	{ return m_scopes[ scope ].m_parent; }
 
-private:
+	void AddSymbol( int scope, const std::string& symbol, double value, bool isLabel = false );
+	void AddBuiltInSymbol( const std::string& symbol, double value );
+	void AddBoundSymbol( const std::string& symbol, const int* pValue );
+	bool AddCommandLineSymbol( const std::string& expr );
+	void ChangeSymbol( int scope, const std::string& symbol, double value );
+	double GetSymbol( int scope, const std::string& symbol ) const;
+	bool IsSymbolDefined( int scope, const std::string& symbol ) const;
+	void RemoveSymbol( int scope, const std::string& symbol );
+
+	// Handle-based access, for callers which look a symbol up and then use it straight away.
+	// Handles are only valid until the next symbol is added or removed.
+
+	int FindSymbol( int scope, const char* symbol, size_t length ) const;
+	inline int FindSymbol( int scope, const std::string& symbol ) const { return FindSymbol( scope, symbol.data(), symbol.length() ); }
+	int ResolveSymbol( int scope, const char* symbol, size_t length ) const;
+	inline int ResolveSymbol( int scope, const std::string& symbol ) const { return ResolveSymbol( scope, symbol.data(), symbol.length() ); }
+	int ResolveSymbol( int scope, unsigned int nameHash, const char* symbol, size_t length ) const;
+	int FindSymbol( int scope, unsigned int nameHash, const char* symbol, size_t length ) const;
+
+	// Callers can hash a name once and keep it, and can keep a handle found from a given scope
+	// for as long as the generation is unchanged, i.e. until a symbol is added or removed
+
+	static unsigned int Hash( const char* symbol, size_t length );
+	inline unsigned int GetGeneration() const		{ return m_generation; }
+	inline double GetSymbolValue( int handle ) const
+	{
+		assert( IsValidHandle( handle ) );
+		const Symbol& entry = m_symbols[ handle ];
+		return ( entry.m_pBinding != NULL ) ? *entry.m_pBinding : entry.m_value;
+	}
 
-	class Symbol
+	inline void SetSymbolValue( int handle, double value )
 	{
-	public:
+		assert( IsValidHandle( handle ) );
+		assert( m_symbols[ handle ].m_pBinding == NULL );
+		m_symbols[ handle ].m_value = value;
+	}
 
-		Symbol( double value, bool isLabel ) : m_value( value ), m_isLabel( isLabel ) {}
+	void Dump() const;
+	void GetGlobalSymbols( std::map<std::string, double>& symbols ) const;
 
-		void SetValue( double d ) { m_value = d; }
-		double GetValue() const { return m_value; }
-		bool IsLabel() const { return m_isLabel; }
 
-	private:
+private:
 
-		double	m_value;
-		bool	m_isLabel;
+	struct Symbol
+	{
+		std::string		m_name;
+		int				m_scope;
+		unsigned int	m_hash;
+		double			m_value;
+		bool			m_isLabel;
+		bool			m_isUsed;
+		bool			m_isBuiltIn;	// defined by the assembler itself, e.g. PI, CPU or P%
+		const int*		m_pBinding;	// if non-NULL, the symbol is a read-only view of this variable
+		int				m_next;		// next symbol in the same hash bucket, or next free slot
+	};
+
+	struct Scope
+	{
+		int				m_parent;
+		int				m_id;
+		int				m_count;
+		int				m_numSymbols;
+		int				m_numChildren;
+		bool			m_isHeld;		// never freed, e.g. because a single pass fixup refers to it
 	};
 
 	SymbolTable();
 	~SymbolTable();
 
-	std::map<std::string, Symbol>	m_map;
+	static inline unsigned int Hash( int scope, unsigned int nameHash ) { return nameHash ^ ( static_cast< unsigned int >( scope ) * 2654435761u ); }
+	static bool CompareSymbolNames( const Symbol* a, const Symbol* b ) { return a->m_name < b->m_name; }
+
+	inline bool IsValidHandle( int handle ) const
+	{
+		return handle >= 0 && handle < static_cast< int >( m_symbols.size() ) && m_symbols[ handle ].m_isUsed;
+	}
+
+	void Insert( int scope, const std::string& symbol, double value, bool isLabel );
+	void Rehash( size_t numBuckets );
+
+	std::vector<Symbol>				m_symbols;
+	std::vector<int>				m_buckets;
+	int								m_firstFree;
+	size_t							m_numSymbols;
+	unsigned int					m_generation;
 
-	static SymbolTable*				m_gInstance;
+	std::vector<Scope>				m_scopes;
+	std::vector<int>				m_freeScopes;
+	std::map<std::pair<int, std::pair<int, int> >, int>	m_scopeIds;
 };
 
 
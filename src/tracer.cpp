@@ -0,0 +1,373 @@
+/*************************************************************************************************/
+/**
+	tracer.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <cstdio>
+
+#include "tracer.h"
+#include "stringutils.h"
+
+
+using namespace std;
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::Create()
+
+	Creates the Tracer singleton
+*/
+/*************************************************************************************************/
+void Tracer::Create()
+{
+	assert( AssemblyContext::Current().m_pTracer == NULL );
+
+	AssemblyContext::Current().m_pTracer = new Tracer;
+	Instrumentation::Add( AssemblyContext::Current().m_pTracer );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::Destroy()
+
+	Destroys the Tracer singleton
+*/
+/*************************************************************************************************/
+void Tracer::Destroy()
+{
+	assert( AssemblyContext::Current().m_pTracer != NULL );
+
+	Instrumentation::Remove( AssemblyContext::Current().m_pTracer );
+	delete AssemblyContext::Current().m_pTracer;
+	AssemblyContext::Current().m_pTracer = NULL;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::Tracer()
+
+	Tracer constructor
+*/
+/*************************************************************************************************/
+Tracer::Tracer()
+	:	m_start( Clock::now() ),
+		m_depth( 0 )
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::~Tracer()
+
+	Tracer destructor
+*/
+/*************************************************************************************************/
+Tracer::~Tracer()
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::GetTime()
+
+	Returns the time since the tracer was created, in microseconds
+*/
+/*************************************************************************************************/
+double Tracer::GetTime() const
+{
+	return chrono::duration< double, micro >( Clock::now() - m_start ).count();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::Begin()
+
+	Begins a span
+
+	@param		pCategory		Kind of span, e.g. "macro"
+	@param		name			Name of the span, as shown in the timeline
+*/
+/*************************************************************************************************/
+void Tracer::Begin( const char* pCategory, const string& name )
+{
+	Event event;
+	event.m_bIsBegin = true;
+	event.m_pCategory = pCategory;
+	event.m_name = name;
+	event.m_microseconds = GetTime();
+	event.m_pArgName = NULL;
+	event.m_arg = 0;
+	m_events.push_back( event );
+
+	m_depth++;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::End()
+
+	Ends the innermost span
+
+	@param		pArgName		If non-NULL, the name of a value to show with the span
+	@param		arg				The value
+*/
+/*************************************************************************************************/
+void Tracer::End( const char* pArgName, long arg )
+{
+	if ( m_depth == 0 )
+	{
+		return;
+	}
+
+	Event event;
+	event.m_bIsBegin = false;
+	event.m_pCategory = NULL;
+	event.m_microseconds = GetTime();
+	event.m_pArgName = pArgName;
+	event.m_arg = arg;
+	m_events.push_back( event );
+
+	m_depth--;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::EndTo()
+
+	Ends spans until only the given number remain open
+
+	@param		depth			Number of spans to leave open
+*/
+/*************************************************************************************************/
+void Tracer::EndTo( size_t depth )
+{
+	while ( m_depth > depth )
+	{
+		End();
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::BeginPass()
+
+	Begins a pass, which is the outermost span
+
+	@param		name			Name of the pass
+*/
+/*************************************************************************************************/
+void Tracer::BeginPass( const string& name )
+{
+	EndPass();
+	Begin( "pass", name );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::EndPass()
+
+	Ends the current pass, along with any spans left open inside it by an error
+*/
+/*************************************************************************************************/
+void Tracer::EndPass()
+{
+	EndTo( 0 );
+	m_outerDepths.clear();
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::EnterSource()
+
+	Begins a span for a source file or macro instance
+
+	@param		name			Filename, or macro name
+	@param		bIsMacro		Whether it is a macro instance
+*/
+/*************************************************************************************************/
+void Tracer::EnterSource( const string& name, bool bIsMacro )
+{
+	m_outerDepths.push_back( m_depth );
+	Begin( bIsMacro ? "macro" : "file", name );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::ExitSource()
+
+	Ends the span for the innermost source file or macro instance, along with any FOR loops still
+	open inside it
+*/
+/*************************************************************************************************/
+void Tracer::ExitSource( const string&, bool, unsigned long )
+{
+	if ( !m_outerDepths.empty() )
+	{
+		EndTo( m_outerDepths.back() );
+		m_outerDepths.pop_back();
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::BeginFor()
+
+	Begins a span for a FOR loop
+
+	@param		filename		File containing the FOR
+	@param		lineNumber		Line number of the FOR
+*/
+/*************************************************************************************************/
+void Tracer::BeginFor( const string& filename, int lineNumber )
+{
+	char buffer[ 16 ];
+	sprintf( buffer, ":%d", lineNumber );
+	Begin( "for", "FOR " + filename + buffer );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::EndFor()
+
+	Ends the span for the innermost FOR loop
+
+	@param		numIterations	Number of times its body was assembled
+*/
+/*************************************************************************************************/
+void Tracer::EndFor( int numIterations )
+{
+	End( "iterations", numIterations );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::BeginWrite()
+
+	Begins a span for a SAVE or a write to the disc image
+
+	@param		pKind			"save" or "disc"
+	@param		name			Name of the file
+*/
+/*************************************************************************************************/
+void Tracer::BeginWrite( const char* pKind, const string& name )
+{
+	m_outerDepths.push_back( m_depth );
+	Begin( pKind, name );
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::EndWrite()
+
+	Ends the span for the innermost write
+*/
+/*************************************************************************************************/
+void Tracer::EndWrite()
+{
+	if ( !m_outerDepths.empty() )
+	{
+		EndTo( m_outerDepths.back() );
+		m_outerDepths.pop_back();
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	Tracer::Write()
+
+	Writes the trace out as JSON, ending any spans which are still open
+
+	@param		stream			Where to write it
+*/
+/*************************************************************************************************/
+void Tracer::Write( ostream& stream ) const
+{
+	char buffer[ 64 ];
+	double endTime = GetTime();
+
+	stream << "{" << endl << "\"displayTimeUnit\": \"ms\"," << endl << "\"traceEvents\": [" << endl;
+
+	for ( vector< Event >::const_iterator it = m_events.begin(); it != m_events.end(); ++it )
+	{
+		sprintf( buffer, "%.3f", it->m_microseconds );
+
+		if ( it->m_bIsBegin )
+		{
+			stream << "{\"ph\": \"B\", \"ts\": " << buffer << ", \"pid\": 1, \"tid\": 1, \"cat\": \""
+				   << it->m_pCategory << "\", \"name\": " << StringUtils::QuoteJson( it->m_name ) << "}";
+		}
+		else
+		{
+			stream << "{\"ph\": \"E\", \"ts\": " << buffer << ", \"pid\": 1, \"tid\": 1";
+
+			if ( it->m_pArgName != NULL )
+			{
+				stream << ", \"args\": {\"" << it->m_pArgName << "\": " << it->m_arg << "}";
+			}
+
+			stream << "}";
+		}
+
+		stream << ( ( it + 1 != m_events.end() || m_depth > 0 ) ? "," : "" ) << endl;
+	}
+
+	sprintf( buffer, "%.3f", endTime );
+
+	for ( size_t i = m_depth; i > 0; i-- )
+	{
+		stream << "{\"ph\": \"E\", \"ts\": " << buffer << ", \"pid\": 1, \"tid\": 1}" << ( i > 1 ? "," : "" ) << endl;
+	}
+
+	stream << "]" << endl << "}" << endl;
+}
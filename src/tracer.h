@@ -0,0 +1,89 @@
+/*************************************************************************************************/
+/**
+	tracer.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "instrumentation.h"
+
+
+// Records a timeline of spans (passes, source files, macro instances, FOR loops, saves and
+// disc writes) as written by --trace, in the trace event format read by Chrome's trace viewer
+// and Perfetto.  Spans nest, so each one is ended before the one it is inside.
+
+class Tracer : public Instrument
+{
+public:
+
+	static void Create();
+	static void Destroy();
+	static inline Tracer* Get() { return AssemblyContext::Current().m_pTracer; }
+
+	virtual void BeginPass( const std::string& name );
+	virtual void EndPass();
+	virtual void EnterSource( const std::string& name, bool bIsMacro );
+	virtual void ExitSource( const std::string& name, bool bIsMacro, unsigned long numLines );
+	virtual void BeginFor( const std::string& filename, int lineNumber );
+	virtual void EndFor( int numIterations );
+	virtual void BeginWrite( const char* pKind, const std::string& name );
+	virtual void EndWrite();
+
+	void Write( std::ostream& stream ) const;
+
+
+private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Event
+	{
+		bool				m_bIsBegin;
+		const char*			m_pCategory;
+		std::string			m_name;
+		double				m_microseconds;		// since the tracer was created
+		const char*			m_pArgName;			// if non-NULL, an argument to show with the span
+		long				m_arg;
+	};
+
+	Tracer();
+	virtual ~Tracer();
+
+	double GetTime() const;
+	void Begin( const char* pCategory, const std::string& name );
+	void End( const char* pArgName = NULL, long arg = 0 );
+	void EndTo( size_t depth );
+
+	Clock::time_point		m_start;
+	std::vector< Event >	m_events;
+	size_t					m_depth;			// number of spans begun but not ended
+	std::vector< size_t >	m_outerDepths;		// m_depth outside each open source file, macro and write
+};
+
+
+
+#endif // TRACER_H_
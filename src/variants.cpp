@@ -0,0 +1,285 @@
+/*************************************************************************************************/
+/**
+	variants.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "variants.h"
+#include "assemblycontext.h"
+#include "globaldata.h"
+#include "symboltable.h"
+
+
+using namespace std;
+
+
+
+/*************************************************************************************************/
+/**
+	VariantBuild::VariantBuild()
+
+	VariantBuild constructor; this must be called in the context which holds the settings from
+	the command line
+
+	@param		options			What to assemble; the symbols are defined for every variant
+*/
+/*************************************************************************************************/
+VariantBuild::VariantBuild( const AssemblyOptions& options )
+	:	m_options( options ),
+		m_globalData( GlobalData::Instance() ),
+		m_nextVariant( 0 )
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	VariantBuild::ReadVariants()
+
+	Reads the list of variants.  Each line names a variant, followed by the symbols to define for
+	it, separated by spaces and each written as for -D.  Blank lines and lines starting with '#'
+	are ignored.
+
+	@param		pFilename		File listing the variants
+
+	@return		bool			false if the file couldn't be read, or was invalid
+*/
+/*************************************************************************************************/
+bool VariantBuild::ReadVariants( const char* pFilename )
+{
+	ifstream file( pFilename );
+
+	if ( !file )
+	{
+		cerr << "Could not open variants file: " << pFilename << endl;
+		return false;
+	}
+
+	set< string > names;
+	string line;
+
+	while ( getline( file, line ) )
+	{
+		istringstream fields( line );
+		Variant variant;
+
+		if ( !( fields >> variant.m_name ) || variant.m_name[ 0 ] == '#' )
+		{
+			continue;
+		}
+
+		if ( !names.insert( variant.m_name ).second )
+		{
+			cerr << "Variant named more than once: " << variant.m_name << endl;
+			return false;
+		}
+
+		string symbol;
+
+		while ( fields >> symbol )
+		{
+			variant.m_symbols.push_back( symbol );
+		}
+
+		variant.m_bSucceeded = false;
+		variant.m_bSaved = false;
+		m_variants.push_back( variant );
+	}
+
+	if ( m_variants.empty() )
+	{
+		cerr << "No variants in " << pFilename << endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	VariantBuild::Run()
+
+	Assembles all the variants, and then outputs what each one printed, in the order in which they
+	were listed
+
+	@param		numThreads		Number of threads to assemble on
+
+	@return		bool			true if every variant assembled without error
+*/
+/*************************************************************************************************/
+bool VariantBuild::Run( int numThreads )
+{
+	for ( vector< Variant >::const_iterator it = m_variants.begin(); it != m_variants.end(); ++it )
+	{
+#ifdef _WIN32
+		_mkdir( it->m_name.c_str() );
+#else
+		mkdir( it->m_name.c_str(), 0777 );
+#endif
+	}
+
+	// This thread takes a share of the work too
+
+	vector< thread > threads;
+	m_nextVariant = 0;
+
+	for ( int i = 1; i < numThreads && i < static_cast< int >( m_variants.size() ); i++ )
+	{
+		threads.push_back( thread( RunThread, this ) );
+	}
+
+	RunThread( this );
+
+	for ( vector< thread >::iterator it = threads.begin(); it != threads.end(); ++it )
+	{
+		it->join();
+	}
+
+	bool bSucceeded = true;
+
+	for ( vector< Variant >::const_iterator it = m_variants.begin(); it != m_variants.end(); ++it )
+	{
+		cout << it->m_output;
+
+		if ( !it->m_errors.empty() )
+		{
+			cerr << "Variant " << it->m_name << ":" << endl << it->m_errors;
+		}
+		else if ( !it->m_bSaved )
+		{
+			cerr << "warning: no SAVE command in source file (variant " << it->m_name << ")." << endl;
+		}
+
+		bSucceeded = bSucceeded && it->m_bSucceeded;
+	}
+
+	return bSucceeded;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	VariantBuild::RunThread()
+
+	Assembles variants until there are none left
+
+	@param		pBuild			The VariantBuild
+*/
+/*************************************************************************************************/
+void VariantBuild::RunThread( VariantBuild* pBuild )
+{
+	for ( ;; )
+	{
+		size_t i;
+
+		{
+			lock_guard< mutex > lock( pBuild->m_mutex );
+			i = pBuild->m_nextVariant++;
+		}
+
+		if ( i >= pBuild->m_variants.size() )
+		{
+			return;
+		}
+
+		pBuild->AssembleVariant( pBuild->m_variants[ i ] );
+	}
+}
+
+
+
+/*************************************************************************************************/
+/**
+	VariantBuild::AssembleVariant()
+
+	Assembles one variant in a context of its own
+
+	@param		variant			Variant to assemble, which receives the results
+*/
+/*************************************************************************************************/
+void VariantBuild::AssembleVariant( Variant& variant )
+{
+	AssemblyContext context;
+	ostringstream output;
+	ostringstream errors;
+
+	GlobalData::Instance().SetOptions( m_globalData );
+	GlobalData::Instance().SetSharedFiles( &m_sharedFiles );
+	GlobalData::Instance().SetPrintStream( &output );
+	GlobalData::Instance().SetOutputDirectory( variant.m_name );
+
+	// A symbol given both with -D and by the variant takes the variant's value
+
+	set< string > variantSymbolNames;
+
+	for ( vector< string >::const_iterator it = variant.m_symbols.begin(); it != variant.m_symbols.end(); ++it )
+	{
+		variantSymbolNames.insert( it->substr( 0, it->find( '=' ) ) );
+	}
+
+	AssemblyOptions options( m_options );
+	options.m_symbols.clear();
+
+	for ( vector< string >::const_iterator it = m_options.m_symbols.begin(); it != m_options.m_symbols.end(); ++it )
+	{
+		if ( variantSymbolNames.count( it->substr( 0, it->find( '=' ) ) ) == 0 )
+		{
+			options.m_symbols.push_back( *it );
+		}
+	}
+
+	options.m_symbols.insert( options.m_symbols.end(), variant.m_symbols.begin(), variant.m_symbols.end() );
+
+	bool bSucceeded = true;
+
+	for ( vector< string >::const_iterator it = options.m_symbols.begin(); it != options.m_symbols.end(); ++it )
+	{
+		if ( !SymbolTable::Instance().AddCommandLineSymbol( *it ) )
+		{
+			errors << "Invalid -D expression: " << *it << endl;
+			bSucceeded = false;
+		}
+	}
+
+	if ( bSucceeded )
+	{
+		bSucceeded = Assemble( options, errors );
+	}
+
+	variant.m_bSucceeded = bSucceeded;
+	variant.m_bSaved = GlobalData::Instance().IsSaved();
+	variant.m_output = output.str();
+	variant.m_errors = errors.str();
+}
@@ -0,0 +1,76 @@
+/*************************************************************************************************/
+/**
+	variants.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef VARIANTS_H_
+#define VARIANTS_H_
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "assembly.h"
+#include "sharedfiles.h"
+
+
+class GlobalData;
+
+
+// Assembles the same source several times over with different -D symbols, sharing the variants
+// out between several threads.  Each variant saves its files, and its disc image if there is one,
+// into a directory named after it.  The source files are only read once, and shared between all
+// the variants.
+
+class VariantBuild
+{
+public:
+
+	explicit VariantBuild( const AssemblyOptions& options );
+
+	bool ReadVariants( const char* pFilename );
+	bool Run( int numThreads );
+
+
+private:
+
+	struct Variant
+	{
+		std::string					m_name;
+		std::vector< std::string >	m_symbols;
+		bool						m_bSucceeded;
+		bool						m_bSaved;
+		std::string					m_output;			// PRINT output
+		std::string					m_errors;
+	};
+
+	static void RunThread( VariantBuild* pBuild );
+	void AssembleVariant( Variant& variant );
+
+	const AssemblyOptions&		m_options;
+	const GlobalData&			m_globalData;			// settings from the command line
+	std::vector< Variant >		m_variants;
+	SharedFiles					m_sharedFiles;
+	std::mutex					m_mutex;				// guards m_nextVariant
+	size_t						m_nextVariant;
+};
+
+
+
+#endif // VARIANTS_H_
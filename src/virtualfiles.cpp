@@ -0,0 +1,87 @@
+/*************************************************************************************************/
+/**
+	virtualfiles.cpp
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#include "virtualfiles.h"
+
+
+using namespace std;
+
+
+
+/*************************************************************************************************/
+/**
+	VirtualFiles::VirtualFiles()
+
+	VirtualFiles constructor
+
+	@param		files			Contents of each file, keyed by filename; this must outlive the
+								VirtualFiles
+*/
+/*************************************************************************************************/
+VirtualFiles::VirtualFiles( const map< string, string >& files )
+	:	m_files( files )
+{
+}
+
+
+
+/*************************************************************************************************/
+/**
+	VirtualFiles::Find()
+
+	@param		filename		Filename, exactly as given in the source
+
+	@return		const string*	Contents of the file, or NULL if there is no such file
+*/
+/*************************************************************************************************/
+const string* VirtualFiles::Find( const string& filename ) const
+{
+	map< string, string >::const_iterator it = m_files.find( filename );
+
+	return ( it != m_files.end() ) ? &it->second : NULL;
+}
+
+
+
+/*************************************************************************************************/
+/**
+	VirtualFiles::AddFile()
+
+	Keeps a block saved by the source; the parameters are as for DiscImage::AddFile()
+
+	@param		pName			Filename
+	@param		pAddr			Start of the data
+	@param		load			Load address
+	@param		exec			Execution address
+	@param		len				Length of the data
+*/
+/*************************************************************************************************/
+void VirtualFiles::AddFile( const char* pName, const unsigned char* pAddr, int load, int exec, int len )
+{
+	m_saveBlocks.push_back( SaveBlock() );
+
+	SaveBlock& block = m_saveBlocks.back();
+	block.m_filename = pName;
+	block.m_load = load;
+	block.m_exec = exec;
+	block.m_data.assign( pAddr, pAddr + len );
+}
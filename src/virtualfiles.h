@@ -0,0 +1,63 @@
+/*************************************************************************************************/
+/**
+	virtualfiles.h
+
+
+	Copyright (C) Rich Talbot-Watkins 2007 - 2012
+
+	This file is part of BeebAsm.
+
+	BeebAsm is free software: you can redistribute it and/or modify it under the terms of the GNU
+	General Public License as published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	BeebAsm is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+	even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License along with BeebAsm, as
+	COPYING.txt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*************************************************************************************************/
+
+#ifndef VIRTUALFILES_H_
+#define VIRTUALFILES_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+// Files held in memory, for assembling without touching the filesystem.  Source, INCBIN, PUTFILE
+// and PUTTEXT files are looked up by name in a map, and SAVE keeps the blocks it would have
+// written.
+
+class VirtualFiles
+{
+public:
+
+	struct SaveBlock
+	{
+		std::string						m_filename;
+		int								m_load;
+		int								m_exec;
+		std::vector< unsigned char >	m_data;
+	};
+
+	explicit VirtualFiles( const std::map< std::string, std::string >& files );
+
+	const std::string* Find( const std::string& filename ) const;
+
+	void AddFile( const char* pName, const unsigned char* pAddr, int load, int exec, int len );
+	inline const std::vector< SaveBlock >& GetSaveBlocks() const	{ return m_saveBlocks; }
+
+
+private:
+
+	const std::map< std::string, std::string >&		m_files;
+	std::vector< SaveBlock >						m_saveBlocks;
+};
+
+
+
+#endif // VIRTUALFILES_H_